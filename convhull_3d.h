@@ -36,6 +36,9 @@
  *     If your project has CBLAS linked, then you can also speed things up
  *     a tad by adding this:
  *         #define CONVHULL_3D_USE_CBLAS
+ *     On x86-64 Linux, the visibility tests use SSE2/AVX2/AVX-512 kernels,
+ *     picked at runtime. To use plain C loops instead, add this:
+ *         #define CONVHULL_3D_DISABLE_SIMD
  *     The code is C++ compiler safe.
  *     Reference: "The Quickhull Algorithm for Convex Hull, C. Bradford
  *                 Barber, David P. Dobkin and Hannu Huhdanpaa, Geometry
@@ -64,6 +67,7 @@ typedef struct _ch_vertex
     CH_FLOAT v[3];
     */
 #include <array>
+#include <atomic>
 using ch_vertex = std::array<double, 3>;
 typedef ch_vertex ch_vec3;
 
@@ -75,6 +79,200 @@ void convhull_3d_build(/* input arguments */
                        int **out_faces, /* & of empty int*, output face indices; flat: nOut_faces x 3 */
                        int *nOut_faces); /* & of int, number of output face indices */
 
+/* Status codes reported by the builders */
+typedef enum _ch_status
+{
+    CH_OK = 0, /* the hull was built */
+    CH_ERROR_DEGENERATE, /* the input vertices do not span all of the dimensions */
+    CH_ERROR_NUMERIC, /* a face could not be oriented, so the hull could not be completed */
+    CH_ERROR_FACE_BUDGET, /* the hull needed more faces than allowed by the face budget */
+    CH_ERROR_MEMORY, /* the memory for the build could not be allocated */
+    CH_ERROR_INVALID_ARGUMENT, /* an argument is out of range (e.g. the number of dimensions) */
+    CH_CANCELLED /* the build was stopped by its time budget or cancellation flag; the output is the hull of the points
+                  * processed so far (see convhull_3d_unprocessed()) */
+} ch_status;
+
+/* Orders in which the points are taken up by the builders */
+typedef enum _ch_insertion_order
+{
+    CH_ORDER_DISTANCE = 0, /* farthest from the centre of the points first */
+    CH_ORDER_MORTON, /* along a Morton (Z-order) curve through the bounding box of the points, which keeps the points
+                      * that are near each other in space near each other in memory */
+    CH_ORDER_BRIO /* biased randomised insertion order: rounds of random samples, each about twice the size of the
+                   * last, with each round taken along the Morton curve */
+} ch_insertion_order;
+
+/* Options for convhull_3d_build_ctx(); initialise with convhull_3d_options_default() before changing any fields */
+typedef struct _convhull_3d_options
+{
+    int max_faces; /* face budget; building fails with CH_ERROR_FACE_BUDGET if the hull needs more faces. 0: unlimited */
+    int kdop_directions; /* before building, discard the points strictly inside the polytope spanned by the extreme
+                          * points along 6, 14 or 26 directions (k-DOP). 0: off. Default: 14 */
+    int num_threads; /* number of threads for the k-DOP culling, the sorting of large inputs,
+                      * convhull_3d_build_parallel() and convhull_3d_build_batch(). Default: 1 */
+    int num_chunks; /* number of chunks that convhull_3d_build_parallel() splits the input into. 0: one per thread */
+    unsigned int seed; /* seed of the noise that is added to the input vertices; for a given seed, the output is the
+                        * same on every run, and on every thread. Default: 0 */
+    int exact_predicates; /* 1: decide which side of a face each point is on with exact (adaptive precision)
+                           * predicates, instead of adding noise to the input vertices; which are then read in place
+                           * (in double precision). Default: 0 */
+    int insertion_order; /* order in which the points are taken up (see ch_insertion_order). With CH_ORDER_MORTON or
+                          * CH_ORDER_BRIO, the points are also copied in that order, so the hull is built on points
+                          * that are local in memory. Default: CH_ORDER_DISTANCE */
+    int lower_hull; /* convhull_nd_build_opt() only; 1: build just the lower hull, i.e. the faces that can be seen from
+                     * below along the last dimension (as needed for Delaunay meshes). Default: 0 */
+    double time_budget; /* 3-D builders (but not convhull_3d_hull) and convhull_nd_build_ex() only; stop with
+                         * CH_CANCELLED once the build has run for this many seconds. Checked between insertions. 0: no
+                         * limit */
+    const std::atomic<int> *cancel; /* 3-D builders (but not convhull_3d_hull) and convhull_nd_build_ex() only; stop
+                                     * with CH_CANCELLED once this is set to non-zero (e.g. by another thread). Checked
+                                     * between insertions. Default: NULL */
+} convhull_3d_options;
+
+/* fills in the default options */
+void convhull_3d_options_default(convhull_3d_options *options);
+
+/* Reusable scratch memory for building many hulls, see convhull_3d_build_ctx() */
+typedef struct _convhull_3d_context convhull_3d_context;
+
+/* creates a context, which owns growable scratch buffers that can be reused by any number of builds */
+convhull_3d_context *convhull_3d_context_create(void);
+
+/* releases the scratch buffers of a context, returning it to the state it was created in */
+void convhull_3d_context_reset(convhull_3d_context *ctx);
+
+/* destroys a context, along with everything it owns */
+void convhull_3d_context_destroy(convhull_3d_context *ctx);
+
+/* builds the 3-D convexhull, like convhull_3d_build(), but takes all of its working memory from 'ctx'. Once the
+ * buffers of 'ctx' have grown to fit, repeated builds of similarly sized inputs do not allocate any memory. Returns
+ * CH_OK, or the reason why the hull could not be built (in which case (*out_faces) is NULL) */
+ch_status convhull_3d_build_ctx(/* input arguments */
+                                convhull_3d_context *ctx, /* reusable context */
+                                ch_vertex *const in_vertices, /* vector of input vertices; nVert x 1 */
+                                const int nVert, /* number of vertices */
+                                const convhull_3d_options *options, /* build options (set to NULL for the defaults) */
+                                /* output arguments */
+                                int **out_faces, /* & of int*, face indices owned by ctx, valid until its next use; flat: nOut_faces x 3 */
+                                int *nOut_faces); /* & of int, number of output face indices */
+
+/* number of points that the last build on ctx (or, for batch builds, on each item) left unprocessed, if it was stopped
+ * with CH_CANCELLED; otherwise 0. These points lie outside of the hull that was output, which is therefore an inner
+ * hull of the input. (The points discarded by the k-DOP culling are not counted, as they are inside the full hull;
+ * but they may also lie outside of a partial one) */
+int convhull_3d_unprocessed(const convhull_3d_context *ctx);
+
+/* builds the 3-D convexhull like convhull_3d_build(), but reports the reason why the hull could not be built as a
+ * status code, rather than by throwing; nor does it throw for any other reason (every allocation is checked, and
+ * CH_ERROR_MEMORY is returned if one fails), so it may be used when building with -fno-exceptions. The output is
+ * allocated separately, and should be freed by the caller; it is NULL unless CH_OK or CH_CANCELLED (in which case it
+ * is the partial hull) is returned */
+ch_status convhull_3d_build_ex(/* input arguments */
+                               ch_vertex *const in_vertices, /* vector of input vertices; nVert x 1 */
+                               const int nVert, /* number of vertices */
+                               const convhull_3d_options *options, /* build options (set to NULL for the defaults) */
+                               /* output arguments */
+                               int **out_faces, /* & of empty int*, output face indices; flat: nOut_faces x 3 */
+                               int *nOut_faces); /* & of int, number of output face indices */
+
+/* builds the 3-D convexhull like convhull_3d_build_ctx(), but warm-started from the faces of a previous hull of
+ * (mostly) the same points, e.g. that of the previous frame, when the points have only moved a little since. The hull
+ * of the vertices of these faces is built first, and then each of the other points is located against it (by a test
+ * against a ball inside it, or otherwise by a walk over its faces), so that the points inside it are only tested
+ * once; the rest are added as usual. Any hint will do (indices that are out of range are skipped), but the better it
+ * is, the fewer points are left over; with fewer than 4 vertices, or coplanar ones, the hull is built from scratch. The
+ * hint may be the previous output of ctx */
+ch_status convhull_3d_build_hint(/* input arguments */
+                                 convhull_3d_context *ctx, /* reusable context */
+                                 ch_vertex *const in_vertices, /* vector of input vertices; nVert x 1 */
+                                 const int nVert, /* number of vertices */
+                                 const convhull_3d_options *options, /* build options (NULL for the defaults) */
+                                 const int *hint_faces, /* faces of the previous hull; flat: nHint_faces x 3 */
+                                 const int nHint_faces, /* number of faces of the previous hull */
+                                 /* output arguments */
+                                 int **out_faces, /* & of int*, face indices owned by ctx, valid until its next use; flat: nOut_faces x 3 */
+                                 int *nOut_faces); /* & of int, number of output face indices */
+
+/* builds the 3-D convexhull like convhull_3d_build_ctx(), but on options->num_threads threads: the input is split
+ * into options->num_chunks contiguous chunks, the hull of each chunk is built on its own, and the final hull is then
+ * built over the union of the vertices of these sub-hulls. For a given number of chunks, the output does not depend
+ * on the number of threads, nor on how the chunks were scheduled */
+ch_status convhull_3d_build_parallel(/* input arguments */
+                                     convhull_3d_context *ctx, /* reusable context */
+                                     ch_vertex *const in_vertices, /* vector of input vertices; nVert x 1 */
+                                     const int nVert, /* number of vertices */
+                                     const convhull_3d_options *options, /* build options (NULL for the defaults) */
+                                     /* output arguments */
+                                     int **out_faces, /* & of int*, face indices owned by ctx, valid until its next use; flat: nOut_faces x 3 */
+                                     int *nOut_faces); /* & of int, number of output face indices */
+
+/* One input/output of convhull_3d_build_batch() */
+typedef struct _convhull_3d_batch_item
+{
+    /* input */
+    ch_vertex *vertices; /* vector of input vertices; nVert x 1 */
+    int nVert; /* number of vertices */
+    /* output */
+    int *faces; /* face indices (free with ch_free()), or NULL if the hull could not be built; flat: nFaces x 3 */
+    int nFaces; /* number of faces */
+    ch_status status; /* CH_OK, or the reason why the hull could not be built */
+    int nUnprocessed; /* number of points left unprocessed, if status is CH_CANCELLED; see convhull_3d_unprocessed() */
+} convhull_3d_batch_item;
+
+/* builds the 3-D convexhulls of many independent point sets, spread over options->num_threads threads. Each thread
+ * has a context of its own (owned by 'ctx'), and takes items from its own queue; a thread that runs out of items
+ * steals them from the other queues. The output of each item does not depend on the number of threads */
+void convhull_3d_build_batch(/* input arguments */
+                             convhull_3d_context *ctx, /* reusable context */
+                             convhull_3d_batch_item *items, /* the point sets, and their output; nItems x 1 */
+                             const int nItems, /* number of point sets */
+                             const convhull_3d_options *options); /* build options (NULL for the defaults) */
+
+/* A hull that points can be added to, removed from, and moved within over time, see convhull_3d_insert() */
+typedef struct _convhull_3d_hull convhull_3d_hull;
+
+/* creates an empty hull; which is built with the given options (NULL for the defaults), except for the insertion
+ * order, as the points are always added in the order that they are given, and for the time budget and cancellation
+ * flag, as an update is never left half done */
+convhull_3d_hull *convhull_3d_hull_create(const convhull_3d_options *options);
+
+/* destroys a hull, along with everything it owns */
+void convhull_3d_hull_destroy(convhull_3d_hull *hull);
+
+/* adds points to the hull. The hull is not rebuilt: the new points are assigned to the outside sets of the faces that
+ * they are above (the others are inside the hull; once points have been removed or moved, these are kept by the faces
+ * that they are under, in case those faces are removed), and then the hull is grown around them, cone by cone, as in
+ * convhull_3d_build(). The i'th point ever added has the index i. Returns CH_OK, or the reason why the hull could not
+ * be built; in which case it is built from scratch by the next update (e.g. once the points span all 3 dimensions) */
+ch_status convhull_3d_insert(/* input arguments */
+                             convhull_3d_hull *hull, /* the hull to add the points to */
+                             ch_vertex *const points, /* vector of the new points; n x 1 */
+                             const int n); /* number of new points */
+
+/* removes points from the hull; their indices are not reused. Removing a point inside the hull costs next to nothing.
+ * Removing a vertex deletes the faces around it, and fills the hole with the hull of the vertices around it and of
+ * the points that those faces kept; so the cost depends on the size of the hole, rather than on that of the hull (the
+ * hull is only rebuilt if the hole cannot be filled, e.g. if these points are coplanar). The first removal (or move)
+ * also takes a pass over all of the points, to start keeping track of the interior points */
+ch_status convhull_3d_remove(/* input arguments */
+                             convhull_3d_hull *hull, /* the hull to remove the points from */
+                             const int *indices, /* indices of the points; n x 1 (removed points are skipped) */
+                             const int n); /* number of points */
+
+/* moves points of the hull to new positions, by removing them and then adding them back, with the same indices */
+ch_status convhull_3d_move(/* input arguments */
+                           convhull_3d_hull *hull, /* the hull */
+                           const int *indices, /* indices of the points; n x 1 (removed points are skipped) */
+                           ch_vertex *const points, /* new positions of the points; n x 1 */
+                           const int n); /* number of points */
+
+/* the faces of the hull (none until it could be built), gathered from the face slots that are in use */
+void convhull_3d_hull_faces(/* input arguments */
+                            convhull_3d_hull *hull, /* the hull */
+                            /* output arguments */
+                            int **out_faces, /* & of int*, face indices owned by hull, valid until its next update; flat: nOut_faces x 3 */
+                            int *nOut_faces); /* & of int, number of output face indices */
+
 /* exports the vertices, face indices, and face normals, as an 'obj' file, ready for GPU (for 3d convexhulls only) */
 void convhull_3d_export_obj(/* input arguments */
                             ch_vertex *const vertices, /* vector of input vertices; nVert x 1 */
@@ -102,11 +300,12 @@ void extractVerticesFromObjFile(/* input arguments */
 
 /**** NEW! ****/
 
-/* builds the N-Dimensional convexhull of a grid of points */
+/* builds the N-Dimensional convexhull of a grid of points. For d = 2, the hull is a polygon, which is built by the
+ * monotone chain algorithm instead; its faces (edges) are output counter-clockwise, in order around the polygon */
 void convhull_nd_build(/* input arguments */
                        CH_FLOAT *const in_points, /* Matrix of points in 'd' dimensions; FLAT: nPoints x d */
                        const int nPoints, /* number of points */
-                       const int d, /* Number of dimensions */
+                       const int d, /* Number of dimensions (at most CONVHULL_ND_MAX_DIMENSIONS, i.e. 10) */
                        /* output arguments */
                        int **out_faces, /* (&) output face indices; FLAT: nOut_faces x d */
                        CH_FLOAT **
@@ -115,11 +314,46 @@ void convhull_nd_build(/* input arguments */
                          out_df, /* (&) contains the constant terms of the planes (set to NULL if not wanted); nOut_faces x 1 */
                        int *nOut_faces); /* (&) number of output face indices */
 
-/* Computes the Delaunay triangulation (mesh) of an arrangement of points in N-dimensional space */
+/* builds the N-Dimensional convexhull like convhull_nd_build(), but with build options; of which only the seed and
+ * the insertion order apply (or, for d = 2, the number of threads and whether the k-DOP culling is on) */
+void convhull_nd_build_opt(/* input arguments */
+                           CH_FLOAT *const in_points, /* Matrix of points in 'd' dimensions; FLAT: nPoints x d */
+                           const int nPoints, /* number of points */
+                           const int d, /* Number of dimensions (at most CONVHULL_ND_MAX_DIMENSIONS) */
+                           const convhull_3d_options *options, /* build options (NULL for the defaults) */
+                           /* output arguments */
+                           int **out_faces, /* (&) output face indices; FLAT: nOut_faces x d */
+                           CH_FLOAT **
+                             out_cf, /* (&) contains the coefficients of the planes (set to NULL if not wanted); FLAT: nOut_faces x d */
+                           CH_FLOAT **
+                             out_df, /* (&) contains the constant terms of the planes (set to NULL if not wanted); nOut_faces x 1 */
+                           int *nOut_faces); /* (&) number of output face indices */
+
+/* builds the N-Dimensional convexhull like convhull_nd_build_opt(), but returns a status code instead of throwing:
+ * CH_ERROR_DEGENERATE if the points do not span all 'd' dimensions, CH_ERROR_NUMERIC if a face cannot be oriented,
+ * CH_ERROR_FACE_BUDGET if the hull needs more than options->max_faces faces, CH_ERROR_MEMORY if an allocation fails,
+ * CH_ERROR_INVALID_ARGUMENT if 'd' is not from 2 to CONVHULL_ND_MAX_DIMENSIONS, or CH_CANCELLED (with the hull of
+ * the points taken up so far) if options->time_budget runs out or options->cancel is set. The outputs are NULL unless
+ * CH_OK or CH_CANCELLED is returned */
+ch_status convhull_nd_build_ex(/* input arguments */
+                               CH_FLOAT *const in_points, /* Matrix of points in 'd' dimensions; FLAT: nPoints x d */
+                               const int nPoints, /* number of points */
+                               const int d, /* Number of dimensions (at most CONVHULL_ND_MAX_DIMENSIONS) */
+                               const convhull_3d_options *options, /* build options (NULL for the defaults) */
+                               /* output arguments */
+                               int **out_faces, /* (&) output face indices; FLAT: nOut_faces x d */
+                               CH_FLOAT **
+                                 out_cf, /* (&) contains the coefficients of the planes (set to NULL if not wanted); FLAT: nOut_faces x d */
+                               CH_FLOAT **
+                                 out_df, /* (&) contains the constant terms of the planes (set to NULL if not wanted); nOut_faces x 1 */
+                               int *nOut_faces); /* (&) number of output face indices */
+
+/* Computes the Delaunay triangulation (mesh) of an arrangement of points in N-dimensional space. For nd = 2 and 3, it
+ * is built directly, by incremental insertion; otherwise, from the lower hull of the points lifted onto a paraboloid */
 void delaunay_nd_mesh(/* input Arguments */
                       const float *points, /* The input points; FLAT: nPoints x nd */
                       const int nPoints, /* Number of points */
-                      const int nd, /* The number of dimensions */
+                      const int nd, /* The number of dimensions (at most CONVHULL_ND_MAX_DIMENSIONS-1) */
                       /* output Arguments */
                       int **
                         Mesh, /* (&) the indices defining the Delaunay triangulation of the points; FLAT: nMesh x (nd+1) */
@@ -140,7 +374,29 @@ void delaunay_nd_mesh(/* input Arguments */
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#include <stdexcept>
+#define CH_EXCEPTIONS
+#define CH_THROW(msg) throw std::runtime_error(msg)
+#else
+#define CH_THROW(msg) ((void)0) /* without exceptions, the builders that cannot return a status leave their output empty */
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define CH_PTHREADS /* worker threads are started with pthread_create(), which reports failure rather than throwing */
+#else
+#include <thread>
+#endif
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#if !defined(CONVHULL_3D_DISABLE_SIMD) && defined(__x86_64__) && defined(__linux__) && (defined(__GNUC__) || defined(__clang__))
+#define CH_SIMD_X86 /* SSE2/AVX2/AVX-512 visibility kernels, picked at runtime */
+#include <immintrin.h>
+#endif
 #if defined(_MSC_VER) && !defined(_CRT_SECURE_NO_WARNINGS)
 #define CV_STRNCPY(a, b, c) strncpy_s(a, c + 1, b, c);
 #define CV_STRCAT(a, b) strcat_s(a, sizeof(b), b);
@@ -151,15 +407,19 @@ void delaunay_nd_mesh(/* input Arguments */
 #ifdef CONVHULL_3D_USE_SINGLE_PRECISION
 #define CH_FLT_MIN FLT_MIN
 #define CH_FLT_MAX FLT_MAX
+#define CH_FLT_EPSILON FLT_EPSILON
 #define CH_NOISE_VAL 0.00001f
 #define ch_pow powf
 #define ch_sqrt sqrtf
+#define ch_fabs fabsf
 #else
 #define CH_FLT_MIN DBL_MIN
 #define CH_FLT_MAX DBL_MAX
+#define CH_FLT_EPSILON DBL_EPSILON
 #define CH_NOISE_VAL 0.0000001
 #define ch_pow pow
 #define ch_sqrt sqrt
+#define ch_fabs fabs
 #endif
 #ifndef MIN
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))
@@ -179,145 +439,258 @@ void delaunay_nd_mesh(/* input Arguments */
 #ifndef ch_free
 #define ch_free free
 #endif
-#define CH_MAX_NUM_FACES 50000
-#define CONVHULL_ND_MAX_DIMENSIONS 5
+#if defined(CH_PTHREADS) && !defined(ch_pthread_create)
+#define ch_pthread_create pthread_create
+#endif
+#define CONVHULL_ND_MAX_DIMENSIONS 10
+#define CH_SIMD_ALIGN 64 /* alignment of the plane coefficient arrays, in bytes */
+#define CH_SIMD_PAD 16 /* the plane coefficient arrays are padded to a multiple of this many entries */
+#define CH_MAX_THREADS 64 /* maximum number of threads used by a build */
+#define CH_RADIX_BITS 8 /* bits per digit of the radix sort */
+#define CH_RADIX_SIZE (1 << CH_RADIX_BITS)
+#define CH_RADIX_PAR_MIN 65536 /* fewest keys for which the radix sort is spread over several threads */
+#define CH_KDOP_MAX_AXES 13 /* directions of the 26-DOP, without their opposites */
+#define CH_KDOP_TOL (1000 * CH_FLT_EPSILON) /* relative tolerance for the k-DOP polytope */
+#define CH_ASSIGN_BLOCK 1024 /* faces per call of the visibility kernel, when looking for a face that a point is above */
+#define CH_WALK_GRID 16 /* cells along each side of the cube of directions that walks over the faces start from */
+
+/* Counter-based hash (the splitmix64 finaliser) of a seed and a counter */
+static uint64_t ch_hash(const uint64_t seed, const uint64_t counter)
+{
+    uint64_t z;
+    z = seed + (counter + 1) * 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
 
-/* structs for qsort */
-typedef struct float_w_idx
+/* Counter-based noise in [0,1): a hash of the seed and the index of the coordinate. Unlike rand(), there is no shared
+ * state, so each coordinate can be jittered independently, on any thread */
+static CH_FLOAT ch_noise(const uint64_t seed, const uint64_t counter)
 {
-    CH_FLOAT val;
-    int idx;
-} float_w_idx;
+    return (CH_FLOAT)((double)(ch_hash(seed, counter) >> 11) * (1.0 / 9007199254740992.0)); /* top 53 bits, over 2^53 */
+}
+
+/* Grows the buffer (*ptr) to hold 'n' elements, keeping its contents. Returns 0, and leaves it as it was, if the memory
+ * cannot be had */
+template <typename T>
+static int ch_grow(T **ptr, const size_t n)
+{
+    T *p;
+    p = (T *)ch_realloc(*ptr, MAX(n, size_t(1)) * sizeof(T));
+    if (p == NULL)
+        return 0;
+    (*ptr) = p;
+    return 1;
+}
 
-typedef struct int_w_idx
+/* struct for sorting: an (unsigned) key, along with the index that it came from */
+typedef struct key_w_idx
 {
-    int val;
+    uint64_t val;
     int idx;
-} int_w_idx;
+} key_w_idx;
+
+/* struct for pairing up the ridges of a new cone of faces */
+typedef struct ridge_key
+{
+    int v[CONVHULL_ND_MAX_DIMENSIONS]; /* sorted vertex indices of the ridge, padded with -1 */
+    int face; /* face on one side of the ridge */
+    int slot; /* position of the vertex in 'face' that is opposite the ridge */
+} ridge_key;
 
 /* internal functions prototypes: */
-static int cmp_asc_float(const void *, const void *);
-static int cmp_desc_float(const void *, const void *);
-static int cmp_asc_int(const void *, const void *);
-static int cmp_desc_int(const void *, const void *);
-static void sort_float(CH_FLOAT *, CH_FLOAT *, int *, int, int);
-static void sort_int(int *, int *, int *, int, int);
+static uint64_t float_key(const CH_FLOAT);
+static CH_FLOAT key_float(const uint64_t);
+static void sort_keys(key_w_idx *, key_w_idx *, const int, const int);
+static int sort_float(CH_FLOAT *, CH_FLOAT *, int *, int, int);
+static void sort_float_ws(CH_FLOAT *, CH_FLOAT *, int *, int, int, key_w_idx *, const int);
+static int sort_int(int *, int *, int *, int, int);
 static ch_vec3 cross(const ch_vec3 &, const ch_vec3 &);
 static CH_FLOAT det_4x4(CH_FLOAT *);
+template <typename T>
+static int orient2d(const T *, const T *, const T *);
+template <typename T>
+static int orient3d(const T *, const T *, const T *, const T *);
+static int incircle(const double *, const double *, const double *, const double *);
+static int insphere(const double *, const double *, const double *, const double *, const double *);
 static void plane_3d(CH_FLOAT *, CH_FLOAT *, CH_FLOAT *);
-static void ismember(int *, int *, int *, int, int);
+static int cmp_ridge_key(const void *, const void *);
+static void link_cone(const int, int *, int *, const int *, const int, const int, int *, int *, ridge_key *);
+static int compact_faces(const int, const int, int *, int *, CH_FLOAT *, const int, int *);
 
 /* internal functions definitions: */
-static int cmp_asc_float(const void *a, const void *b)
-{
-    struct float_w_idx *a1 = (struct float_w_idx *)a;
-    struct float_w_idx *a2 = (struct float_w_idx *)b;
-    if ((*a1).val < (*a2).val)
-        return -1;
-    else if ((*a1).val > (*a2).val)
-        return 1;
-    else
-        return 0;
-}
 
-static int cmp_desc_float(const void *a, const void *b)
+/* Maps a float onto an unsigned key that sorts in the same order: the sign bit of a positive value is set, and all of
+ * the bits of a negative value are flipped */
+static uint64_t float_key(const CH_FLOAT x)
 {
-    struct float_w_idx *a1 = (struct float_w_idx *)a;
-    struct float_w_idx *a2 = (struct float_w_idx *)b;
-    if ((*a1).val > (*a2).val)
-        return -1;
-    else if ((*a1).val < (*a2).val)
-        return 1;
-    else
-        return 0;
+#ifdef CONVHULL_3D_USE_SINGLE_PRECISION
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return (uint64_t)(u & 0x80000000u ? ~u : u | 0x80000000u);
+#else
+    uint64_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u & 0x8000000000000000ull ? ~u : u | 0x8000000000000000ull;
+#endif
 }
 
-static int cmp_asc_int(const void *a, const void *b)
+/* The inverse of float_key() */
+static CH_FLOAT key_float(const uint64_t key)
 {
-    struct int_w_idx *a1 = (struct int_w_idx *)a;
-    struct int_w_idx *a2 = (struct int_w_idx *)b;
-    if ((*a1).val < (*a2).val)
-        return -1;
-    else if ((*a1).val > (*a2).val)
-        return 1;
-    else
-        return 0;
+    CH_FLOAT x;
+#ifdef CONVHULL_3D_USE_SINGLE_PRECISION
+    uint32_t u;
+    u = (uint32_t)key;
+    u = u & 0x80000000u ? u & 0x7FFFFFFFu : ~u;
+#else
+    uint64_t u;
+    u = key & 0x8000000000000000ull ? key & 0x7FFFFFFFFFFFFFFFull : ~key;
+#endif
+    memcpy(&x, &u, sizeof(x));
+    return x;
 }
 
-static int cmp_desc_int(const void *a, const void *b)
+/* Returns 0, having done nothing, if the memory for sorting cannot be had (as does sort_int()) */
+static int sort_float(CH_FLOAT *in_vec, /* vector[len] to be sorted */
+                      CH_FLOAT *out_vec, /* if NULL, then in_vec is sorted "in-place" */
+                      int *new_idices, /* set to NULL if you don't need them */
+                      int len, /* number of elements in vectors, must be consistent with the input data */
+                      int descendFLAG /* !1:ascending, 1:descending */
+)
 {
-    struct int_w_idx *a1 = (struct int_w_idx *)a;
-    struct int_w_idx *a2 = (struct int_w_idx *)b;
-    if ((*a1).val > (*a2).val)
-        return -1;
-    else if ((*a1).val < (*a2).val)
-        return 1;
-    else
+    struct key_w_idx *data;
+
+    data = (key_w_idx *)ch_malloc(size_t(MAX(len, 1)) * 2 * sizeof(key_w_idx));
+    if (data == NULL)
         return 0;
+    sort_float_ws(in_vec, out_vec, new_idices, len, descendFLAG, data, 1);
+    ch_free(data);
+    return 1;
 }
 
-static void sort_float(CH_FLOAT *in_vec, /* vector[len] to be sorted */
-                       CH_FLOAT *out_vec, /* if NULL, then in_vec is sorted "in-place" */
-                       int *new_idices, /* set to NULL if you don't need them */
-                       int len, /* number of elements in vectors, must be consistent with the input data */
-                       int descendFLAG /* !1:ascending, 1:descending */
+/* Like sort_float(), but takes its scratch space from the caller, and sorts on 'nThreads' threads (if there are enough
+ * values to make it worthwhile). The sort is stable, so equal values keep their input order */
+static void sort_float_ws(CH_FLOAT *in_vec, /* vector[len] to be sorted */
+                          CH_FLOAT *out_vec, /* if NULL, then in_vec is sorted "in-place" */
+                          int *new_idices, /* set to NULL if you don't need them */
+                          int len, /* number of elements in vectors, must be consistent with the input data */
+                          int descendFLAG, /* !1:ascending, 1:descending */
+                          key_w_idx *data, /* scratch space; 2*len x 1 */
+                          const int nThreads /* number of threads */
 )
 {
     int i;
-    struct float_w_idx *data;
 
-    data = (float_w_idx *)ch_malloc(size_t(len) * sizeof(float_w_idx));
     for (i = 0; i < len; i++)
     {
-        data[i].val = in_vec[i];
+        data[i].val = descendFLAG ? ~float_key(in_vec[i]) : float_key(in_vec[i]);
         data[i].idx = int(i);
     }
-    if (descendFLAG)
-        qsort(data, size_t(len), sizeof(data[0]), cmp_desc_float);
-    else
-        qsort(data, size_t(len), sizeof(data[0]), cmp_asc_float);
+    sort_keys(data, data + len, len, nThreads);
     for (i = 0; i < len; i++)
     {
         if (out_vec != NULL)
-            out_vec[i] = data[i].val;
+            out_vec[i] = key_float(descendFLAG ? ~data[i].val : data[i].val);
         else
-            in_vec[i] = data[i].val; /* overwrite input vector */
+            in_vec[i] = key_float(descendFLAG ? ~data[i].val : data[i].val); /* overwrite input vector */
         if (new_idices != NULL)
             new_idices[i] = data[i].idx;
     }
-    ch_free(data);
 }
 
-static void sort_int(int *in_vec, /* vector[len] to be sorted */
-                     int *out_vec, /* if NULL, then in_vec is sorted "in-place" */
-                     int *new_idices, /* set to NULL if you don't need them */
-                     int len, /* number of elements in vectors, must be consistent with the input data */
-                     int descendFLAG /* !1:ascending, 1:descending */
+static int sort_int(int *in_vec, /* vector[len] to be sorted */
+                    int *out_vec, /* if NULL, then in_vec is sorted "in-place" */
+                    int *new_idices, /* set to NULL if you don't need them */
+                    int len, /* number of elements in vectors, must be consistent with the input data */
+                    int descendFLAG /* !1:ascending, 1:descending */
 )
 {
     int i;
-    struct int_w_idx *data;
+    struct key_w_idx *data;
+    uint64_t key;
 
-    data = (int_w_idx *)ch_malloc(size_t(len) * sizeof(int_w_idx));
+    /* the sign bit is flipped, so that the keys sort in the same order as the values */
+    data = (key_w_idx *)ch_malloc(size_t(MAX(len, 1)) * 2 * sizeof(key_w_idx));
+    if (data == NULL)
+        return 0;
     for (i = 0; i < len; i++)
     {
-        data[i].val = in_vec[i];
+        key = (uint64_t)((uint32_t)in_vec[i] ^ 0x80000000u);
+        data[i].val = descendFLAG ? 0xFFFFFFFFull - key : key;
         data[i].idx = int(i);
     }
-    if (descendFLAG)
-        qsort(data, size_t(len), sizeof(data[0]), cmp_desc_int);
-    else
-        qsort(data, size_t(len), sizeof(data[0]), cmp_asc_int);
+    sort_keys(data, data + len, len, 1);
     for (i = 0; i < len; i++)
     {
+        key = descendFLAG ? 0xFFFFFFFFull - data[i].val : data[i].val;
         if (out_vec != NULL)
-            out_vec[i] = data[int(i)].val;
+            out_vec[i] = (int)((uint32_t)key ^ 0x80000000u);
         else
-            in_vec[i] = data[int(i)].val; /* overwrite input vector */
+            in_vec[i] = (int)((uint32_t)key ^ 0x80000000u); /* overwrite input vector */
         if (new_idices != NULL)
-            new_idices[i] = data[int(i)].idx;
+            new_idices[i] = data[i].idx;
     }
     ch_free(data);
+    return 1;
+}
+
+/* Sorts the points (of any coordinate type) along a Morton (Z-order) curve through their bounding box: each coordinate
+ * is quantised to (58/d) bits, and the bits of the d coordinates are interleaved into one key. With 'brio', each point
+ * is also put in a random round, which takes the top 6 bits of the key: a point is in round r (from the end) if the
+ * hash of its index has r trailing zeros, so the last round holds about half of the points, the round before it about
+ * a quarter, and so on. The points with equal keys keep their input order. order[i] is set to the i'th point */
+template <typename T>
+static void insertion_order(const T *pts, /* points; flat: nVert x stride */
+                            const int stride, /* distance between the points (at least d) */
+                            const int nVert, /* number of points */
+                            const int d, /* number of dimensions */
+                            const int brio, /* 1: randomised rounds, 0: just the Morton order */
+                            const unsigned int seed, /* seed of the rounds */
+                            const int nThreads, /* number of threads for sorting */
+                            key_w_idx *data, /* scratch space; 2*nVert x 1 */
+                            int *order) /* the points in insertion order; nVert x 1 */
+{
+    int i, j, b, bits, round;
+    uint64_t key, h, q[CONVHULL_ND_MAX_DIMENSIONS];
+    double lo[CONVHULL_ND_MAX_DIMENSIONS], scale[CONVHULL_ND_MAX_DIMENSIONS], x;
+
+    bits = 58 / d;
+    for (j = 0; j < d; j++)
+    {
+        lo[j] = (double)pts[j];
+        scale[j] = (double)pts[j];
+        for (i = 1; i < nVert; i++)
+        {
+            lo[j] = MIN(lo[j], (double)pts[i * stride + j]);
+            scale[j] = MAX(scale[j], (double)pts[i * stride + j]);
+        }
+        scale[j] = scale[j] > lo[j] ? ((double)(1ull << bits) - 1.0) / (scale[j] - lo[j]) : 0.0;
+    }
+    for (i = 0; i < nVert; i++)
+    {
+        for (j = 0; j < d; j++)
+        {
+            x = ((double)pts[i * stride + j] - lo[j]) * scale[j];
+            q[j] = x > 0.0 ? (uint64_t)x : 0;
+        }
+        for (b = bits - 1, key = 0; b >= 0; b--)
+            for (j = 0; j < d; j++)
+                key = (key << 1) | ((q[j] >> b) & 1);
+        if (brio)
+        {
+            h = ch_hash(~uint64_t(seed), uint64_t(i));
+            for (round = 0; round < 63 && !((h >> round) & 1); round++)
+                ;
+            key |= uint64_t(63 - round) << 58;
+        }
+        data[i].val = key;
+        data[i].idx = i;
+    }
+    sort_keys(data, data + nVert, nVert, nThreads);
+    for (i = 0; i < nVert; i++)
+        order[i] = data[i].idx;
 }
 
 static ch_vec3 cross(const ch_vec3 &v1, const ch_vec3 &v2)
@@ -342,37 +715,478 @@ static CH_FLOAT det_4x4(CH_FLOAT *m)
            m[0] * m[6] * m[9] * m[15] - m[1] * m[4] * m[10] * m[15] + m[0] * m[5] * m[10] * m[15];
 }
 
-/* Helper function for det_NxN()  */
-static void createSubMatrix(CH_FLOAT *m, int N, int i, CH_FLOAT *sub_m)
+/* calculates the determinent of an NxN matrix (or of an nxn matrix, if N == 0), by its LU decomposition with partial
+ * pivoting */
+template <int N>
+static CH_FLOAT det_nd(const int n, const CH_FLOAT *m)
 {
-    int j, k;
-    for (j = N, k = 0; j < N * N; j++)
+    constexpr int nMax = N > 0 ? N : CONVHULL_ND_MAX_DIMENSIONS + 1;
+    const int nn = N > 0 ? N : n;
+    int i, j, k, piv;
+    CH_FLOAT lu[nMax * nMax] = { 0 };
+    CH_FLOAT det, f;
+
+    memcpy(lu, m, size_t(nn * nn) * sizeof(CH_FLOAT));
+    det = 1.0;
+    for (k = 0; k < nn; k++)
+    {
+        /* Swap the row with the largest entry in column k up to row k */
+        piv = k;
+        for (i = k + 1; i < nn; i++)
+            if (fabs(lu[i * nn + k]) > fabs(lu[piv * nn + k]))
+                piv = i;
+        if (lu[piv * nn + k] == 0.0)
+            return 0.0;
+        if (piv != k)
+        {
+            for (j = k; j < nn; j++)
+            {
+                f = lu[k * nn + j];
+                lu[k * nn + j] = lu[piv * nn + j];
+                lu[piv * nn + j] = f;
+            }
+            det = -det;
+        }
+        det *= lu[k * nn + k];
+
+        /* Eliminate column k from the rows below */
+        for (i = k + 1; i < nn; i++)
+        {
+            f = lu[i * nn + k] / lu[k * nn + k];
+            for (j = k + 1; j < nn; j++)
+                lu[i * nn + j] -= f * lu[k * nn + j];
+        }
+    }
+    return det;
+}
+
+/* Exact arithmetic on floating-point expansions (sums of non-overlapping doubles, stored from the smallest to the
+ * largest in magnitude, so that the sign of an expansion is the sign of its last entry), after:
+ * J. R. Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates", Discrete &
+ * Computational Geometry 18(3):305-363, 1997 */
+#define CH_EXPANSION_MAX 512 /* longest product that expansion_product() can form (as needed by incircle_exact()) */
+
+/* x + y = a + b exactly, where x is the rounded sum */
+static void two_sum(const double a, const double b, double *x, double *y)
+{
+    double av, bv;
+    (*x) = a + b;
+    bv = (*x) - a;
+    av = (*x) - bv;
+    (*y) = (a - av) + (b - bv);
+}
+
+/* x + y = a - b exactly, where x is the rounded difference */
+static void two_diff(const double a, const double b, double *x, double *y)
+{
+    double av, bv;
+    (*x) = a - b;
+    bv = a - (*x);
+    av = (*x) + bv;
+    (*y) = (a - av) + (bv - b);
+}
+
+/* x + y = a * b exactly, where x is the rounded product */
+static void two_product(const double a, const double b, double *x, double *y)
+{
+    (*x) = a * b;
+#ifdef FP_FAST_FMA
+    (*y) = fma(a, b, -(*x));
+#else
+    double c, ahi, alo, bhi, blo;
+    c = 134217729.0 * a; /* Dekker's split into two halves of 26 bits, with 2^27 + 1 */
+    ahi = c - (c - a);
+    alo = a - ahi;
+    c = 134217729.0 * b;
+    bhi = c - (c - b);
+    blo = b - bhi;
+    (*y) = alo * blo - ((((*x) - ahi * bhi) - alo * bhi) - ahi * blo);
+#endif
+}
+
+/* h = e + f; returns the length of h, which may be up to elen + flen */
+static int expansion_sum(const int elen, const double *e, const int flen, const double *f, double *h)
+{
+    double q, g, hh;
+    int i, j, n;
+
+    /* Merge the two by magnitude, and accumulate from the smallest up */
+    i = j = n = 0;
+    q = (j >= flen || (i < elen && fabs(e[i]) < fabs(f[j]))) ? e[i++] : f[j++];
+    while (i < elen || j < flen)
+    {
+        g = (j >= flen || (i < elen && fabs(e[i]) < fabs(f[j]))) ? e[i++] : f[j++];
+        two_sum(q, g, &q, &hh);
+        if (hh != 0.0)
+            h[n++] = hh;
+    }
+    if (q != 0.0 || n == 0)
+        h[n++] = q;
+    return n;
+}
+
+/* h = e * b; returns the length of h, which may be up to 2 * elen */
+static int expansion_scale(const int elen, const double *e, const double b, double *h)
+{
+    double q, sum, hh, p1, p0;
+    int i, n;
+
+    n = 0;
+    two_product(e[0], b, &q, &hh);
+    if (hh != 0.0)
+        h[n++] = hh;
+    for (i = 1; i < elen; i++)
+    {
+        two_product(e[i], b, &p1, &p0);
+        two_sum(q, p0, &sum, &hh);
+        if (hh != 0.0)
+            h[n++] = hh;
+        two_sum(p1, sum, &q, &hh);
+        if (hh != 0.0)
+            h[n++] = hh;
+    }
+    if (q != 0.0 || n == 0)
+        h[n++] = q;
+    return n;
+}
+
+/* h = e * f; returns the length of h, which may be up to 2 * elen * flen. 'ws' is scratch space of the same length as
+ * h, and elen may be at most CH_EXPANSION_MAX/2 */
+static int expansion_product_ws(const int elen, const double *e, const int flen, const double *f, double *h, double *ws)
+{
+    double t[CH_EXPANSION_MAX];
+    int j, n, tlen;
+
+    n = expansion_scale(elen, e, f[0], h);
+    for (j = 1; j < flen; j++)
+    {
+        tlen = expansion_scale(elen, e, f[j], t);
+        memcpy(ws, h, size_t(n) * sizeof(double));
+        n = expansion_sum(n, ws, tlen, t, h);
+    }
+    return n;
+}
+
+/* h = e * f, for products of up to CH_EXPANSION_MAX entries */
+static int expansion_product(const int elen, const double *e, const int flen, const double *f, double *h)
+{
+    double s[CH_EXPANSION_MAX];
+    return expansion_product_ws(elen, e, flen, f, h, s);
+}
+
+/* e = -e */
+static void expansion_negate(const int elen, double *e)
+{
+    for (int i = 0; i < elen; i++)
+        e[i] = -e[i];
+}
+
+/* h = e0 * f0 - e1 * f1, for expansions of length 2 */
+static int expansion_minor(const double *e0, const double *f0, const double *e1, const double *f1, double *h)
+{
+    double a[8], b[8];
+    int alen, blen;
+
+    alen = expansion_product(2, e0, 2, f0, a);
+    blen = expansion_product(2, e1, 2, f1, b);
+    expansion_negate(blen, b);
+    return expansion_sum(alen, a, blen, b, h);
+}
+
+/* Sign of the 2x2 determinant [bx-ax by-ay; cx-ax cy-ay], computed exactly */
+static int orient2d_exact(const double ax, const double ay, const double bx, const double by, const double cx,
+                          const double cy)
+{
+    double u[2][2], v[2][2], h[16];
+    int n;
+
+    two_diff(bx, ax, &u[0][1], &u[0][0]);
+    two_diff(by, ay, &u[1][1], &u[1][0]);
+    two_diff(cx, ax, &v[0][1], &v[0][0]);
+    two_diff(cy, ay, &v[1][1], &v[1][0]);
+    n = expansion_minor(u[0], v[1], u[1], v[0], h);
+    return h[n - 1] > 0.0 ? 1 : (h[n - 1] < 0.0 ? -1 : 0);
+}
+
+/* Sign of the 3x3 determinant [a-d; b-d; c-d], computed exactly */
+static int orient3d_exact(const double *a, const double *b, const double *c, const double *d)
+{
+    double u[3][2], v[3][2], w[3][2], m[16], t[3][64], s[128], h[CH_EXPANSION_MAX];
+    int i, n, mlen, tlen[3];
+
+    for (i = 0; i < 3; i++)
+    {
+        two_diff(a[i], d[i], &u[i][1], &u[i][0]);
+        two_diff(b[i], d[i], &v[i][1], &v[i][0]);
+        two_diff(c[i], d[i], &w[i][1], &w[i][0]);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        /* cofactor of u[i], i.e. the minor of v and w without dimension i */
+        mlen = expansion_minor(v[(i + 1) % 3], w[(i + 2) % 3], v[(i + 2) % 3], w[(i + 1) % 3], m);
+        tlen[i] = expansion_product(2, u[i], mlen, m, t[i]);
+    }
+    n = expansion_sum(tlen[0], t[0], tlen[1], t[1], s);
+    n = expansion_sum(n, s, tlen[2], t[2], h);
+    return h[n - 1] > 0.0 ? 1 : (h[n - 1] < 0.0 ? -1 : 0);
+}
+
+/* Sign of the 3x3 determinant [a-d |a-d|^2; b-d |b-d|^2; c-d |c-d|^2], computed exactly */
+static int incircle_exact(const double *a, const double *b, const double *c, const double *d)
+{
+    double u[3][2][2], sq[2][8], lift[3][16], m[16], t[3][512], s[1024], h[1536];
+    const double *p[3] = { a, b, c };
+    int i, n, sqlen[2], llen[3], mlen, tlen[3];
+
+    for (i = 0; i < 3; i++)
+    {
+        two_diff(p[i][0], d[0], &u[i][0][1], &u[i][0][0]);
+        two_diff(p[i][1], d[1], &u[i][1][1], &u[i][1][0]);
+        sqlen[0] = expansion_product(2, u[i][0], 2, u[i][0], sq[0]);
+        sqlen[1] = expansion_product(2, u[i][1], 2, u[i][1], sq[1]);
+        llen[i] = expansion_sum(sqlen[0], sq[0], sqlen[1], sq[1], lift[i]);
+    }
+    for (i = 0; i < 3; i++)
+    {
+        /* cofactor of lift[i], i.e. the 2x2 minor of the other two rows (in cyclic order) */
+        mlen = expansion_minor(u[(i + 1) % 3][0], u[(i + 2) % 3][1], u[(i + 1) % 3][1], u[(i + 2) % 3][0], m);
+        tlen[i] = expansion_product(llen[i], lift[i], mlen, m, t[i]);
+    }
+    n = expansion_sum(tlen[0], t[0], tlen[1], t[1], s);
+    n = expansion_sum(n, s, tlen[2], t[2], h);
+    return h[n - 1] > 0.0 ? 1 : (h[n - 1] < 0.0 ? -1 : 0);
+}
+
+/* Sign of the 4x4 determinant [a-e |a-e|^2; b-e |b-e|^2; c-e |c-e|^2; d-e |d-e|^2], computed exactly. Its expansions
+ * may be too long for the stack (up to 36864 entries), in which case the scratch space is allocated here; but they are
+ * far shorter for most inputs (e.g. for points on a grid, whose differences and products are exact) */
+static int insphere_exact(const double *a, const double *b, const double *c, const double *d, const double *e)
+{
+    const int tri[4][3] = { { 1, 2, 3 }, { 2, 3, 0 }, { 3, 0, 1 }, { 0, 1, 2 } }; /* rows of the cofactor of lift[i] */
+    double u[4][3][2], sq[3][8], sq01[16], lift[4][24], m[16], mz[3][64], mzz[128], tri_det[4][192];
+    double buf[4 * CH_EXPANSION_MAX], *mem, *term, *ws, *acc, *next, *tmp;
+    const double *p[4] = { a, b, c, d };
+    int i, j, k, n, sqlen[3], llen[4], mlen, mzlen[3], len, tlen[4], maxTerm, total, sign;
+
+    for (i = 0; i < 4; i++)
+    {
+        for (j = 0; j < 3; j++)
+        {
+            two_diff(p[i][j], e[j], &u[i][j][1], &u[i][j][0]);
+            sqlen[j] = expansion_product(2, u[i][j], 2, u[i][j], sq[j]);
+        }
+        len = expansion_sum(sqlen[0], sq[0], sqlen[1], sq[1], sq01);
+        llen[i] = expansion_sum(len, sq01, sqlen[2], sq[2], lift[i]);
+    }
+    for (i = 0, maxTerm = 0, total = 0; i < 4; i++)
+    {
+        /* 3x3 determinant of rows (r0, r1, r2) of [x y z], expanded along z: z0*m12 - z1*m02 + z2*m01 */
+        for (k = 0; k < 3; k++)
+        {
+            const int r0 = tri[i][(k + 1) % 3], r1 = tri[i][(k + 2) % 3];
+            mlen = expansion_minor(u[r0][0], u[r1][1], u[r1][0], u[r0][1], m);
+            mzlen[k] = expansion_product(mlen, m, 2, u[tri[i][k]][2], mz[k]);
+        }
+        len = expansion_sum(mzlen[0], mz[0], mzlen[1], mz[1], mzz);
+        tlen[i] = expansion_sum(len, mzz, mzlen[2], mz[2], tri_det[i]);
+        maxTerm = MAX(maxTerm, 2 * llen[i] * tlen[i]);
+        total += 2 * llen[i] * tlen[i];
+    }
+
+    /* Expanded along the lifted column: lift[3]*det(0,1,2) - lift[2]*det(3,0,1) + lift[1]*det(2,3,0) - lift[0]*det(1,2,3) */
+    mem = 2 * (maxTerm + total) <= 4 * CH_EXPANSION_MAX
+            ? buf
+            : (double *)ch_malloc(size_t(2 * (maxTerm + total)) * sizeof(double));
+    term = mem;
+    ws = term + maxTerm;
+    acc = ws + maxTerm;
+    next = acc + total;
+    for (i = 0, n = 0; i < 4; i++)
     {
-        if (j % N != i)
-        { /* i is the index to remove */
-            sub_m[k] = m[j];
-            k++;
+        len = expansion_product_ws(llen[i], lift[i], tlen[i], tri_det[i], term, ws);
+        if (i % 2 == 0)
+            expansion_negate(len, term);
+        if (n == 0)
+        {
+            memcpy(acc, term, size_t(len) * sizeof(double));
+            n = len;
+        }
+        else
+        {
+            n = expansion_sum(n, acc, len, term, next);
+            tmp = acc;
+            acc = next;
+            next = tmp;
         }
     }
+    sign = acc[n - 1] > 0.0 ? 1 : (acc[n - 1] < 0.0 ? -1 : 0);
+    if (mem != buf)
+        ch_free(mem);
+    return sign;
+}
+
+/* Sign of the determinant [b-a; c-a], i.e. positive if a, b and c appear counter-clockwise. As with orient3d(), it is only
+ * recomputed exactly if the floating point sign cannot be trusted */
+template <typename T>
+static int orient2d(const T *pa, const T *pb, const T *pc)
+{
+    const double errbound = (3.0 + 16.0 * DBL_EPSILON / 2.0) * (DBL_EPSILON / 2.0);
+    double detleft, detright, det;
+
+    detleft = ((double)pb[0] - (double)pa[0]) * ((double)pc[1] - (double)pa[1]);
+    detright = ((double)pb[1] - (double)pa[1]) * ((double)pc[0] - (double)pa[0]);
+    det = detleft - detright;
+    if (det > errbound * (fabs(detleft) + fabs(detright)))
+        return 1;
+    if (-det > errbound * (fabs(detleft) + fabs(detright)))
+        return -1;
+    return orient2d_exact((double)pa[0], (double)pa[1], (double)pb[0], (double)pb[1], (double)pc[0], (double)pc[1]);
 }
 
-static CH_FLOAT det_NxN(CH_FLOAT *m, int d)
+/* Sign of the determinant of [a 1; b 1; c 1; d 1], i.e. positive if d is below the plane through a, b and c (which
+ * appear counter-clockwise when seen from above it). The determinant is first evaluated in floating point; only if its
+ * sign cannot be trusted, is it recomputed exactly */
+template <typename T>
+static int orient3d(const T *pa, const T *pb, const T *pc, const T *pd)
 {
-    CH_FLOAT sum;
-    CH_FLOAT sub_m[CONVHULL_ND_MAX_DIMENSIONS * CONVHULL_ND_MAX_DIMENSIONS];
-    int sign;
+    const double errbound = (7.0 + 56.0 * DBL_EPSILON / 2.0) * (DBL_EPSILON / 2.0);
+    double a[3], b[3], c[3], d[3];
+    double adx, bdx, cdx, ady, bdy, cdy, adz, bdz, cdz;
+    double bdxcdy, cdxbdy, cdxady, adxcdy, adxbdy, bdxady, det, permanent;
+    int i;
 
-    if (d == 0)
-        return 1.0;
-    sum = 0.0;
-    sign = 1;
-    for (int i = 0; i < d; i++)
+    for (i = 0; i < 3; i++)
     {
-        createSubMatrix(m, d, i, sub_m);
-        sum += sign * m[i] * det_NxN(sub_m, d - 1);
-        sign *= -1;
+        a[i] = (double)pa[i];
+        b[i] = (double)pb[i];
+        c[i] = (double)pc[i];
+        d[i] = (double)pd[i];
     }
-    return sum;
+    adx = a[0] - d[0];
+    bdx = b[0] - d[0];
+    cdx = c[0] - d[0];
+    ady = a[1] - d[1];
+    bdy = b[1] - d[1];
+    cdy = c[1] - d[1];
+    adz = a[2] - d[2];
+    bdz = b[2] - d[2];
+    cdz = c[2] - d[2];
+    bdxcdy = bdx * cdy;
+    cdxbdy = cdx * bdy;
+    cdxady = cdx * ady;
+    adxcdy = adx * cdy;
+    adxbdy = adx * bdy;
+    bdxady = bdx * ady;
+    det = adz * (bdxcdy - cdxbdy) + bdz * (cdxady - adxcdy) + cdz * (adxbdy - bdxady);
+    permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * fabs(adz) + (fabs(cdxady) + fabs(adxcdy)) * fabs(bdz) +
+                (fabs(adxbdy) + fabs(bdxady)) * fabs(cdz);
+    if (det > errbound * permanent)
+        return 1;
+    if (-det > errbound * permanent)
+        return -1;
+    return orient3d_exact(a, b, c, d);
+}
+
+/* Sign of the determinant [a-d |a-d|^2; b-d |b-d|^2; c-d |c-d|^2], i.e. positive if d lies inside the circle through a,
+ * b and c (which appear counter-clockwise). As with orient3d(), it is only recomputed exactly if the floating point
+ * sign cannot be trusted */
+static int incircle(const double *a, const double *b, const double *c, const double *d)
+{
+    const double errbound = (10.0 + 96.0 * DBL_EPSILON / 2.0) * (DBL_EPSILON / 2.0);
+    double adx, bdx, cdx, ady, bdy, cdy, alift, blift, clift;
+    double bdxcdy, cdxbdy, cdxady, adxcdy, adxbdy, bdxady, det, permanent;
+
+    adx = a[0] - d[0];
+    bdx = b[0] - d[0];
+    cdx = c[0] - d[0];
+    ady = a[1] - d[1];
+    bdy = b[1] - d[1];
+    cdy = c[1] - d[1];
+    bdxcdy = bdx * cdy;
+    cdxbdy = cdx * bdy;
+    cdxady = cdx * ady;
+    adxcdy = adx * cdy;
+    adxbdy = adx * bdy;
+    bdxady = bdx * ady;
+    alift = adx * adx + ady * ady;
+    blift = bdx * bdx + bdy * bdy;
+    clift = cdx * cdx + cdy * cdy;
+    det = alift * (bdxcdy - cdxbdy) + blift * (cdxady - adxcdy) + clift * (adxbdy - bdxady);
+    permanent = (fabs(bdxcdy) + fabs(cdxbdy)) * alift + (fabs(cdxady) + fabs(adxcdy)) * blift +
+                (fabs(adxbdy) + fabs(bdxady)) * clift;
+    if (det > errbound * permanent)
+        return 1;
+    if (-det > errbound * permanent)
+        return -1;
+    return incircle_exact(a, b, c, d);
+}
+
+/* Sign of the determinant [a-e |a-e|^2; b-e |b-e|^2; c-e |c-e|^2; d-e |d-e|^2], i.e. positive if e lies inside the
+ * sphere through a, b, c and d (where orient3d(a, b, c, d) > 0). As with orient3d(), it is only recomputed
+ * exactly if the floating point sign cannot be trusted */
+static int insphere(const double *a, const double *b, const double *c, const double *d, const double *e)
+{
+    const double errbound = (16.0 + 224.0 * DBL_EPSILON / 2.0) * (DBL_EPSILON / 2.0);
+    double aex, bex, cex, dex, aey, bey, cey, dey, aez, bez, cez, dez, alift, blift, clift, dlift;
+    double aexbey, bexaey, bexcey, cexbey, cexdey, dexcey, dexaey, aexdey, aexcey, cexaey, bexdey, dexbey;
+    double ab, bc, cd, da, ac, bd, abc, bcd, cda, dab, det, permanent;
+
+    aex = a[0] - e[0];
+    bex = b[0] - e[0];
+    cex = c[0] - e[0];
+    dex = d[0] - e[0];
+    aey = a[1] - e[1];
+    bey = b[1] - e[1];
+    cey = c[1] - e[1];
+    dey = d[1] - e[1];
+    aez = a[2] - e[2];
+    bez = b[2] - e[2];
+    cez = c[2] - e[2];
+    dez = d[2] - e[2];
+    aexbey = aex * bey;
+    bexaey = bex * aey;
+    ab = aexbey - bexaey;
+    bexcey = bex * cey;
+    cexbey = cex * bey;
+    bc = bexcey - cexbey;
+    cexdey = cex * dey;
+    dexcey = dex * cey;
+    cd = cexdey - dexcey;
+    dexaey = dex * aey;
+    aexdey = aex * dey;
+    da = dexaey - aexdey;
+    aexcey = aex * cey;
+    cexaey = cex * aey;
+    ac = aexcey - cexaey;
+    bexdey = bex * dey;
+    dexbey = dex * bey;
+    bd = bexdey - dexbey;
+    abc = aez * bc - bez * ac + cez * ab;
+    bcd = bez * cd - cez * bd + dez * bc;
+    cda = cez * da + dez * ac + aez * cd;
+    dab = dez * ab + aez * bd + bez * da;
+    alift = aex * aex + aey * aey + aez * aez;
+    blift = bex * bex + bey * bey + bez * bez;
+    clift = cex * cex + cey * cey + cez * cez;
+    dlift = dex * dex + dey * dey + dez * dez;
+    det = (dlift * abc - clift * dab) + (blift * cda - alift * bcd);
+    aez = fabs(aez);
+    bez = fabs(bez);
+    cez = fabs(cez);
+    dez = fabs(dez);
+    permanent = ((fabs(cexdey) + fabs(dexcey)) * bez + (fabs(dexbey) + fabs(bexdey)) * cez +
+                 (fabs(bexcey) + fabs(cexbey)) * dez) * alift +
+                ((fabs(dexaey) + fabs(aexdey)) * cez + (fabs(aexcey) + fabs(cexaey)) * dez +
+                 (fabs(cexdey) + fabs(dexcey)) * aez) * blift +
+                ((fabs(aexbey) + fabs(bexaey)) * dez + (fabs(bexdey) + fabs(dexbey)) * aez +
+                 (fabs(dexaey) + fabs(aexdey)) * bez) * clift +
+                ((fabs(bexcey) + fabs(cexbey)) * aez + (fabs(cexaey) + fabs(aexcey)) * bez +
+                 (fabs(aexbey) + fabs(bexaey)) * cez) * dlift;
+    if (det > errbound * permanent)
+        return 1;
+    if (-det > errbound * permanent)
+        return -1;
+    return insphere_exact(a, b, c, d, e);
 }
 
 /* Calculates the coefficients of the equation of a PLANE in 3D.
@@ -421,158 +1235,1819 @@ static void plane_3d(CH_FLOAT *p, CH_FLOAT *c, CH_FLOAT *d)
         (*d) += -p[i] * c[i];
 }
 
-/* Calculates the coefficients of the equation of a PLANE in ND.
- * Original Copyright (c) 2014, George Papazafeiropoulos
- * Distributed under the BSD (2-clause) license
- */
+/* Calculates the coefficients of the equation of a PLANE in ND, through the Nd points in p (Nd x Nd). The normal spans
+ * the null space of the Nd-1 edges p[i]-p[0], i.e. it is the last column of Q in their Householder QR decomposition.
+ * Its sign follows the (cofactor) convention that det([c; p[1]-p[0]; ...; p[Nd-1]-p[0]]) > 0, which holds when the
+ * product of the diagonal of R is positive */
+template <int D>
 static void plane_nd(const int Nd, CH_FLOAT *p, CH_FLOAT *c, CH_FLOAT *d)
 {
-    int i, j, k, l;
-    int r[CONVHULL_ND_MAX_DIMENSIONS];
-    CH_FLOAT sign, det, norm_c;
-    CH_FLOAT pdiff[CONVHULL_ND_MAX_DIMENSIONS - 1][CONVHULL_ND_MAX_DIMENSIONS],
-      pdiff_s[(CONVHULL_ND_MAX_DIMENSIONS - 1) * (CONVHULL_ND_MAX_DIMENSIONS - 1)];
+    constexpr int nMax = D > 0 ? D : CONVHULL_ND_MAX_DIMENSIONS;
+    const int n = D > 0 ? D : Nd;
+    int i, j, k, flip;
+    CH_FLOAT a[(nMax - 1) * nMax] = { 0 }, vv[nMax] = { 0 };
+    CH_FLOAT norm, s;
 
-    if (Nd == 3)
+    if (n == 3)
     {
         plane_3d(p, c, d);
         return;
     }
 
-    for (i = 0; i < Nd - 1; i++)
-        for (j = 0; j < Nd; j++)
-            pdiff[i][j] = p[(i + 1) * Nd + j] - p[i * Nd + j];
-    memset(c, 0, size_t(Nd) * sizeof(CH_FLOAT));
-    sign = 1.0;
-    for (i = 0; i < Nd; i++)
-        r[i] = i;
-    for (i = 0; i < Nd; i++)
+    /* The edges are the columns of a (n x n-1), stored column by column */
+    for (j = 0; j < n - 1; j++)
+        for (i = 0; i < n; i++)
+            a[j * n + i] = p[(j + 1) * n + i] - p[i];
+
+    /* Householder QR: the reflector of column k, v, overwrites it in place (vv[k] = v.v) */
+    flip = 0;
+    for (k = 0; k < n - 1; k++)
     {
-        for (j = 0; j < Nd - 1; j++)
-        {
-            for (k = 0, l = 0; k < Nd; k++)
-            {
-                if (r[k] != i)
-                {
-                    pdiff_s[j * (Nd - 1) + l] = pdiff[j][k];
-                    l++;
-                }
-            }
-        }
-        /* Determinant 1 dimension lower */
-        if (Nd == 3)
-            det = pdiff_s[0 * (Nd - 1) + 0] * pdiff_s[1 * (Nd - 1) + 1] -
-                  pdiff_s[1 * (Nd - 1) + 0] * pdiff_s[0 * (Nd - 1) + 1];
-        else if (Nd == 5)
-            det = det_4x4((CH_FLOAT *)pdiff_s);
+        norm = 0.0;
+        for (i = k; i < n; i++)
+            norm += a[k * n + i] * a[k * n + i];
+        norm = sqrt(norm);
+        if (norm == 0.0)
+            continue; /* degenerate face */
+
+        /* R[k][k] = -sign(a[k][k]) * norm, so that v does not suffer from cancellation */
+        if (a[k * n + k] < 0.0)
+            norm = -norm;
         else
+            flip ^= 1;
+        a[k * n + k] += norm;
+        vv[k] = norm * a[k * n + k];
+        for (j = k + 1; j < n - 1; j++)
         {
-            det = det_NxN((CH_FLOAT *)pdiff_s, Nd - 1);
+            s = 0.0;
+            for (i = k; i < n; i++)
+                s += a[k * n + i] * a[j * n + i];
+            s /= vv[k];
+            for (i = k; i < n; i++)
+                a[j * n + i] -= s * a[k * n + i];
         }
-        c[i] = sign * det;
-        sign *= -1.0;
     }
-    norm_c = (CH_FLOAT)0.0;
-    for (i = 0; i < Nd; i++)
-        norm_c += (pow(c[i], 2.0));
-    norm_c = sqrt(norm_c);
-    for (i = 0; i < Nd; i++)
-        c[i] /= norm_c;
+
+    /* c = Q e_n, applying the reflectors to e_n in reverse order */
+    for (i = 0; i < n; i++)
+        c[i] = 0.0;
+    c[n - 1] = flip ? -1.0 : 1.0;
+    for (k = n - 2; k >= 0; k--)
+    {
+        if (vv[k] == 0.0)
+            continue;
+        s = 0.0;
+        for (i = k; i < n; i++)
+            s += a[k * n + i] * c[i];
+        s /= vv[k];
+        for (i = k; i < n; i++)
+            c[i] -= s * a[k * n + i];
+    }
     (*d) = (CH_FLOAT)0.0;
-    for (i = 0; i < Nd; i++)
+    for (i = 0; i < n; i++)
         (*d) += -p[i] * c[i];
 }
 
-static void ismember(int *pLeft, /* left vector; nLeftElements x 1 */
-                     int *pRight, /* right vector; nRightElements x 1 */
-                     int *pOut, /* 0, unless pRight elements are present in pLeft then 1; nLeftElements x 1 */
-                     int nLeftElements, /* number of elements in pLeft */
-                     int nRightElements /* number of elements in pRight */
-)
+static int cmp_ridge_key(const void *a, const void *b)
 {
-    int i, j;
-    memset(pOut, 0, size_t(nLeftElements) * sizeof(int));
-    for (i = 0; i < nLeftElements; i++)
-        for (j = 0; j < nRightElements; j++)
-            if (pLeft[i] == pRight[j])
-                pOut[i] = 1;
+    struct ridge_key *a1 = (struct ridge_key *)a;
+    struct ridge_key *a2 = (struct ridge_key *)b;
+    for (int i = 0; i < CONVHULL_ND_MAX_DIMENSIONS; i++)
+    {
+        if (a1->v[i] < a2->v[i])
+            return -1;
+        else if (a1->v[i] > a2->v[i])
+            return 1;
+    }
+    return 0;
 }
 
-/* A C version of the 3D quickhull matlab implementation from here:
- * https://www.mathworks.com/matlabcentral/fileexchange/48509-computational-geometry-toolbox?focused=3851550&tab=example
- * (*out_faces) is returned as NULL, if triangulation fails *
- * Original Copyright (c) 2014, George Papazafeiropoulos
- * Distributed under the BSD (2-clause) license
- * Reference: "The Quickhull Algorithm for Convex Hull, C. Bradford Barber, David P. Dobkin
- *             and Hannu Huhdanpaa, Geometry Center Technical Report GCG53, July 30, 1993"
- */
-void convhull_3d_build(ch_vertex *const in_vertices, const int nVert, int **out_faces, int *nOut_faces)
+/* Links the faces of a new cone to each other and to the rest of the hull. The new faces newf[0..nNew) all contain
+ * the vertex 'apex', and new face newf[n] sits on top of the horizon ridge that it shares with face hz_face[n], where
+ * fnbr[hz_face[n]*d + hz_slot[n]] is the link to be redirected to it. fnbr[f*d+k] is the face that shares the ridge
+ * opposite to vertex k of face f (i.e. the face vertices except for faces[f*d+k]) */
+static void link_cone(const int d, /* number of dimensions */
+                      int *faces, /* face indices; flat: nFaces x d */
+                      int *fnbr, /* face neighbours; flat: nFaces x d */
+                      const int *newf, /* the new faces; nNew x 1 */
+                      const int nNew, /* number of new faces */
+                      const int apex, /* vertex shared by all of the new faces */
+                      int *hz_face, /* faces on the other side of the horizon; nNew x 1 */
+                      int *hz_slot, /* slots of the links in hz_face to redirect; nNew x 1 */
+                      ridge_key *keys) /* scratch space; nNew*(d-1) x 1 */
 {
-    int i, j, k, l, h;
-    int nFaces, p, d;
-    int *aVec, *faces;
-    CH_FLOAT dfi, v, max_p, min_p;
-    CH_FLOAT *points, *cf, *cfi, *df, *p_s, *span;
-
-    if (nVert < 3 || in_vertices == NULL)
+    int i, j, k, l, n, a, tmp, nKeys;
+    for (n = 0, nKeys = 0; n < nNew; n++)
     {
-        (*out_faces) = NULL;
-        (*nOut_faces) = 0;
-        return;
-    }
+        i = newf[n];
+        for (a = 0; a < d; a++)
+            if (faces[i * d + a] == apex)
+                break;
 
-    /* 3 dimensions. The code should theoretically work for >=2 dimensions, but "plane_3d" and "det_4x4" are hardcoded for 3,
-     * so would need to be rewritten */
-    d = 3;
+        /* The ridge opposite to the apex is on the horizon */
+        fnbr[i * d + a] = hz_face[n];
+        fnbr[hz_face[n] * d + hz_slot[n]] = i;
 
-    /* Add noise to the points */
-    points = (CH_FLOAT *)malloc(size_t(nVert) * size_t(d + 1) * sizeof(CH_FLOAT));
-    for (i = 0; i < nVert; i++)
-    {
+        /* The remaining ridges contain the apex, and are each shared with one other new face */
         for (j = 0; j < d; j++)
-            points[i * (d + 1) + j] =
-              in_vertices[i][size_t(j)] + CH_NOISE_VAL * rand() / (CH_FLOAT)RAND_MAX; /* noise mitigates duplicates */
-        points[i * (d + 1) + d] = 1.0f; /* add a last column of ones. Used only for determinant calculation */
-    }
-
-    /* Find the span */
-    span = (CH_FLOAT *)malloc(size_t(d) * sizeof(CH_FLOAT));
-    for (j = 0; j < d; j++)
-    {
-        max_p = -2.23e+13;
-        min_p = 2.23e+13;
-        for (i = 0; i < nVert; i++)
         {
-            max_p = MAX(max_p, points[i * (d + 1) + j]);
-            min_p = MIN(min_p, points[i * (d + 1) + j]);
+            if (j == a)
+                continue;
+            for (k = 0, l = 0; k < d; k++)
+                if (k != j && k != a)
+                    keys[nKeys].v[l++] = faces[i * d + k];
+            for (; l < CONVHULL_ND_MAX_DIMENSIONS; l++)
+                keys[nKeys].v[l] = -1;
+            for (k = 1; k < d - 2; k++) /* insertion sort */
+                for (l = k; l > 0 && keys[nKeys].v[l - 1] > keys[nKeys].v[l]; l--)
+                {
+                    tmp = keys[nKeys].v[l];
+                    keys[nKeys].v[l] = keys[nKeys].v[l - 1];
+                    keys[nKeys].v[l - 1] = tmp;
+                }
+            keys[nKeys].face = i;
+            keys[nKeys].slot = j;
+            fnbr[i * d + j] = -1;
+            nKeys++;
         }
-        span[j] = max_p - min_p;
-        /* If you hit this assertion error, then the input vertices do not span all 3 dimensions. Therefore the convex hull cannot be built.
-         * In these cases, reduce the dimensionality of the points and call convhull_nd_build() instead with d<3 */
-        if (span[j] < 0.0000001f)
+    }
+    qsort(keys, size_t(nKeys), sizeof(keys[0]), cmp_ridge_key);
+    for (i = 0; i + 1 < nKeys; i++)
+    {
+        if (cmp_ridge_key(&keys[i], &keys[i + 1]) == 0)
         {
-            throw(std::runtime_error("input does not span all 3 dimensions"));
+            fnbr[keys[i].face * d + keys[i].slot] = keys[i + 1].face;
+            fnbr[keys[i + 1].face * d + keys[i + 1].slot] = keys[i].face;
+            i++;
         }
     }
+}
 
-    /* The initial convex hull is a simplex with (d+1) facets, where d is the number of dimensions */
-    nFaces = (d + 1);
-    faces = (int *)ch_calloc(size_t(nFaces * d), sizeof(int));
-    aVec = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-    for (i = 0; i < nFaces; i++)
-        aVec[i] = i;
-
-    /* Each column of cf contains the coefficients of a plane */
-    cf = (CH_FLOAT *)ch_malloc(size_t(nFaces * d) * sizeof(CH_FLOAT));
-    cfi = (CH_FLOAT *)ch_malloc(size_t(d) * sizeof(CH_FLOAT));
-    df = (CH_FLOAT *)ch_malloc(size_t(nFaces) * sizeof(CH_FLOAT));
-    p_s = (CH_FLOAT *)ch_malloc(size_t(d * d) * sizeof(CH_FLOAT));
-    for (i = 0; i < nFaces; i++)
+/* Removes the deleted faces (those marked with faces[f*d] == -1) from the first nSlots faces, along with their plane
+ * coefficients and neighbours, while keeping the remaining faces in order. fremap[f] is set to the new index of face f
+ * (-1 if deleted), and the number of remaining faces is returned */
+static int compact_faces(const int d, /* number of dimensions */
+                         const int nSlots, /* number of face slots in use, including the deleted ones */
+                         int *faces, /* face indices; flat: nSlots x d */
+                         int *fnbr, /* face neighbours; flat: nSlots x d */
+                         CH_FLOAT *pl, /* plane coefficients (see ch_planes) */
+                         const int ld, /* leading dimension of pl */
+                         int *fremap) /* new index of each face; nSlots x 1 */
+{
+    int j, k, l;
+    for (j = 0, l = 0; j < nSlots; j++)
+    {
+        if (faces[j * d] != -1)
+        {
+            for (k = 0; k < d; k++)
+                faces[l * d + k] = faces[j * d + k];
+            for (k = 0; k < d; k++)
+                fnbr[l * d + k] = fnbr[j * d + k];
+            for (k = 0; k < d + 1; k++)
+                pl[k * ld + l] = pl[k * ld + j];
+            fremap[j] = l;
+            l++;
+        }
+        else
+            fremap[j] = -1;
+    }
+    for (j = 0; j < l * d; j++)
+        fnbr[j] = fnbr[j] == -1 ? -1 : fremap[fnbr[j]];
+    return l;
+}
+
+/* Plane coefficients of the faces, stored as separate arrays (structure of arrays) so that they can be streamed through
+ * the visibility kernels below. Row k<d holds the k'th component of the face normals, and row d holds the constant
+ * terms; i.e., the signed distance of point p from face f is: planes[d*ld+f] + sum_k p[k]*planes[k*ld+f]. Each row
+ * holds 'ld' entries, which is padded so that every row starts on a CH_SIMD_ALIGN byte boundary */
+typedef struct ch_planes
+{
+    CH_FLOAT *data; /* flat: (d+1) x ld */
+    void *mem; /* the allocation that 'data' lies in */
+    int ld; /* capacity of each row */
+} ch_planes;
+
+/* Makes sure that 'pl' can hold at least 'n' faces of dimension 'd'. The first 'nKeep' entries of each row are kept.
+ * Returns 0, leaving 'pl' as it was, if the memory cannot be had */
+static int planes_reserve(ch_planes *pl, const int d, const int nKeep, const int n)
+{
+    int k, ld;
+    void *mem;
+    CH_FLOAT *data;
+    if (n <= pl->ld)
+        return 1;
+    ld = MAX(n, 2 * pl->ld);
+    ld = (ld + CH_SIMD_PAD - 1) / CH_SIMD_PAD * CH_SIMD_PAD;
+    mem = ch_malloc(size_t(d + 1) * size_t(ld) * sizeof(CH_FLOAT) + CH_SIMD_ALIGN);
+    if (mem == NULL)
+        return 0;
+    data = (CH_FLOAT *)(((uintptr_t)mem + CH_SIMD_ALIGN - 1) & ~(uintptr_t)(CH_SIMD_ALIGN - 1));
+    if (pl->data != NULL)
+        for (k = 0; k < d + 1; k++)
+            memcpy(data + size_t(k) * size_t(ld), pl->data + size_t(k) * size_t(pl->ld), size_t(nKeep) * sizeof(CH_FLOAT));
+    ch_free(pl->mem);
+    pl->data = data;
+    pl->mem = mem;
+    pl->ld = ld;
+    return 1;
+}
+
+static void planes_free(ch_planes *pl)
+{
+    ch_free(pl->mem);
+    memset(pl, 0, sizeof(ch_planes));
+}
+
+/* Visibility kernels: compute the signed distances of point 'p' from faces [lo, hi) of 'planes' (see ch_planes), store
+ * them in dist[0 .. hi-lo-1], and set bit b of the bitmask 'mask' (which has (hi-lo+63)/64 words) if face lo+b is
+ * visible from the point, i.e. if its distance is > 0. The distances are accumulated in the same order by every kernel,
+ * starting from the constant term, and with a separate multiply and add for each term (never a fused multiply-add,
+ * which rounds once rather than twice); so every kernel gives the same distances, and the same hull, on any x86-64
+ * CPU. The compiler is also kept from fusing them (e.g. GCC does so by default, given -mfma or -march=native) */
+typedef void (*ch_visibility_kernel)(const int d, const CH_FLOAT *planes, const int ld, const CH_FLOAT *p,
+                                     const int lo, const int hi, CH_FLOAT *dist, uint64_t *mask);
+#if defined(__clang__)
+#define CH_NO_FP_CONTRACT
+#define CH_FP_CONTRACT_OFF _Pragma("clang fp contract(off)")
+#elif defined(__GNUC__)
+#define CH_NO_FP_CONTRACT __attribute__((optimize("fp-contract=off")))
+#define CH_FP_CONTRACT_OFF
+#else
+#define CH_NO_FP_CONTRACT
+#define CH_FP_CONTRACT_OFF
+#endif
+
+/* Faces [lo, hi), one at a time; picks up from bit 'b' of the mask. Also finishes off the SSE2 kernel */
+CH_NO_FP_CONTRACT static void visibility_tail(const int d, const CH_FLOAT *planes, const int ld, const CH_FLOAT *p,
+                                              const int lo, const int hi, int b, CH_FLOAT *dist, uint64_t *mask)
+{
+    CH_FP_CONTRACT_OFF
+    int f, k;
+    CH_FLOAT acc;
+    for (f = lo; f < hi; f++, b++)
+    {
+        acc = planes[d * ld + f];
+        for (k = 0; k < d; k++)
+            acc += p[k] * planes[k * ld + f];
+        dist[b] = acc;
+        if ((b & 63) == 0)
+            mask[b >> 6] = 0;
+        if (acc > 0.0)
+            mask[b >> 6] |= (uint64_t)1 << (b & 63);
+    }
+}
+
+#ifndef CH_SIMD_X86
+static void visibility_scalar(const int d, const CH_FLOAT *planes, const int ld, const CH_FLOAT *p, const int lo,
+                              const int hi, CH_FLOAT *dist, uint64_t *mask)
+{
+    visibility_tail(d, planes, ld, p, lo, hi, 0, dist, mask);
+}
+#else
+#ifdef CONVHULL_3D_USE_SINGLE_PRECISION
+#define CH_SSE_LANES 4
+#define ch_sse_t __m128
+#define ch_sse_set1 _mm_set1_ps
+#define ch_sse_loadu _mm_loadu_ps
+#define ch_sse_storeu _mm_storeu_ps
+#define ch_sse_madd(a, b, c) _mm_add_ps(_mm_mul_ps(a, b), c)
+#define ch_sse_gtz(a) _mm_movemask_ps(_mm_cmpgt_ps(a, _mm_setzero_ps()))
+#define CH_AVX2_LANES 8
+#define ch_avx2_t __m256
+#define ch_avx2_set1 _mm256_set1_ps
+#define ch_avx2_loadu _mm256_loadu_ps
+#define ch_avx2_storeu _mm256_storeu_ps
+#define ch_avx2_madd(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#define ch_avx2_gtz(a) _mm256_movemask_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_GT_OQ))
+#define ch_avx2_tail(n) _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7))
+#define ch_avx2_maskload _mm256_maskload_ps
+#define ch_avx2_maskstore _mm256_maskstore_ps
+#define CH_AVX512_LANES 16
+#define ch_avx512_t __m512
+#define ch_avx512_set1 _mm512_set1_ps
+#define ch_avx512_loadu _mm512_loadu_ps
+#define ch_avx512_storeu _mm512_storeu_ps
+#define ch_avx512_madd(a, b, c) _mm512_add_ps(_mm512_mul_ps(a, b), c)
+#define ch_avx512_gtz(a) _mm512_cmp_ps_mask(a, _mm512_setzero_ps(), _CMP_GT_OQ)
+#define ch_avx512_mask_t __mmask16
+#define ch_avx512_maskz_loadu _mm512_maskz_loadu_ps
+#define ch_avx512_mask_storeu _mm512_mask_storeu_ps
+#else
+#define CH_SSE_LANES 2
+#define ch_sse_t __m128d
+#define ch_sse_set1 _mm_set1_pd
+#define ch_sse_loadu _mm_loadu_pd
+#define ch_sse_storeu _mm_storeu_pd
+#define ch_sse_madd(a, b, c) _mm_add_pd(_mm_mul_pd(a, b), c)
+#define ch_sse_gtz(a) _mm_movemask_pd(_mm_cmpgt_pd(a, _mm_setzero_pd()))
+#define CH_AVX2_LANES 4
+#define ch_avx2_t __m256d
+#define ch_avx2_set1 _mm256_set1_pd
+#define ch_avx2_loadu _mm256_loadu_pd
+#define ch_avx2_storeu _mm256_storeu_pd
+#define ch_avx2_madd(a, b, c) _mm256_add_pd(_mm256_mul_pd(a, b), c)
+#define ch_avx2_gtz(a) _mm256_movemask_pd(_mm256_cmp_pd(a, _mm256_setzero_pd(), _CMP_GT_OQ))
+#define ch_avx2_tail(n) _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), _mm256_setr_epi64x(0, 1, 2, 3))
+#define ch_avx2_maskload _mm256_maskload_pd
+#define ch_avx2_maskstore _mm256_maskstore_pd
+#define CH_AVX512_LANES 8
+#define ch_avx512_t __m512d
+#define ch_avx512_set1 _mm512_set1_pd
+#define ch_avx512_loadu _mm512_loadu_pd
+#define ch_avx512_storeu _mm512_storeu_pd
+#define ch_avx512_madd(a, b, c) _mm512_add_pd(_mm512_mul_pd(a, b), c)
+#define ch_avx512_gtz(a) _mm512_cmp_pd_mask(a, _mm512_setzero_pd(), _CMP_GT_OQ)
+#define ch_avx512_mask_t __mmask8
+#define ch_avx512_maskz_loadu _mm512_maskz_loadu_pd
+#define ch_avx512_mask_storeu _mm512_mask_storeu_pd
+#endif
+
+/* The lane counts all divide 64, so a vector of faces never straddles two words of the mask. The AVX2 and AVX-512
+ * kernels finish off with a masked vector, so that the last few faces are computed in the same way as the others */
+CH_NO_FP_CONTRACT static void visibility_sse2(const int d, const CH_FLOAT *planes, const int ld, const CH_FLOAT *p,
+                                              const int lo, const int hi, CH_FLOAT *dist, uint64_t *mask)
+{
+    CH_FP_CONTRACT_OFF
+    int f, b, k;
+    ch_sse_t pv[CONVHULL_ND_MAX_DIMENSIONS], acc;
+    for (k = 0; k < d; k++)
+        pv[k] = ch_sse_set1(p[k]);
+    for (f = lo, b = 0; f + CH_SSE_LANES <= hi; f += CH_SSE_LANES, b += CH_SSE_LANES)
+    {
+        acc = ch_sse_loadu(planes + d * ld + f);
+        for (k = 0; k < d; k++)
+            acc = ch_sse_madd(pv[k], ch_sse_loadu(planes + k * ld + f), acc);
+        ch_sse_storeu(dist + b, acc);
+        if ((b & 63) == 0)
+            mask[b >> 6] = 0;
+        mask[b >> 6] |= (uint64_t)ch_sse_gtz(acc) << (b & 63);
+    }
+    visibility_tail(d, planes, ld, p, f, hi, b, dist, mask);
+}
+
+CH_NO_FP_CONTRACT __attribute__((target("avx2"))) static void visibility_avx2(const int d, const CH_FLOAT *planes,
+                                                                               const int ld, const CH_FLOAT *p,
+                                                                               const int lo, const int hi,
+                                                                               CH_FLOAT *dist, uint64_t *mask)
+{
+    CH_FP_CONTRACT_OFF
+    int f, b, k;
+    ch_avx2_t pv[CONVHULL_ND_MAX_DIMENSIONS], acc;
+    __m256i tail;
+    for (k = 0; k < d; k++)
+        pv[k] = ch_avx2_set1(p[k]);
+    for (f = lo, b = 0; f + CH_AVX2_LANES <= hi; f += CH_AVX2_LANES, b += CH_AVX2_LANES)
+    {
+        acc = ch_avx2_loadu(planes + d * ld + f);
+        for (k = 0; k < d; k++)
+            acc = ch_avx2_madd(pv[k], ch_avx2_loadu(planes + k * ld + f), acc);
+        ch_avx2_storeu(dist + b, acc);
+        if ((b & 63) == 0)
+            mask[b >> 6] = 0;
+        mask[b >> 6] |= (uint64_t)ch_avx2_gtz(acc) << (b & 63);
+    }
+    if (f < hi)
+    {
+        tail = ch_avx2_tail(hi - f);
+        acc = ch_avx2_maskload(planes + d * ld + f, tail);
+        for (k = 0; k < d; k++)
+            acc = ch_avx2_madd(pv[k], ch_avx2_maskload(planes + k * ld + f, tail), acc);
+        ch_avx2_maskstore(dist + b, tail, acc);
+        if ((b & 63) == 0)
+            mask[b >> 6] = 0;
+        mask[b >> 6] |= (uint64_t)(ch_avx2_gtz(acc) & ((1 << (hi - f)) - 1)) << (b & 63);
+    }
+}
+
+CH_NO_FP_CONTRACT __attribute__((target("avx512f"))) static void visibility_avx512(const int d, const CH_FLOAT *planes,
+                                                                                  const int ld, const CH_FLOAT *p,
+                                                                                  const int lo, const int hi,
+                                                                                  CH_FLOAT *dist, uint64_t *mask)
+{
+    CH_FP_CONTRACT_OFF
+    int f, b, k;
+    ch_avx512_t pv[CONVHULL_ND_MAX_DIMENSIONS], acc;
+    ch_avx512_mask_t tail;
+    for (k = 0; k < d; k++)
+        pv[k] = ch_avx512_set1(p[k]);
+    for (f = lo, b = 0; f + CH_AVX512_LANES <= hi; f += CH_AVX512_LANES, b += CH_AVX512_LANES)
+    {
+        acc = ch_avx512_loadu(planes + d * ld + f);
+        for (k = 0; k < d; k++)
+            acc = ch_avx512_madd(pv[k], ch_avx512_loadu(planes + k * ld + f), acc);
+        ch_avx512_storeu(dist + b, acc);
+        if ((b & 63) == 0)
+            mask[b >> 6] = 0;
+        mask[b >> 6] |= (uint64_t)ch_avx512_gtz(acc) << (b & 63);
+    }
+    if (f < hi)
+    {
+        tail = (ch_avx512_mask_t)((1u << (hi - f)) - 1);
+        acc = ch_avx512_maskz_loadu(tail, planes + d * ld + f);
+        for (k = 0; k < d; k++)
+            acc = ch_avx512_madd(pv[k], ch_avx512_maskz_loadu(tail, planes + k * ld + f), acc);
+        ch_avx512_mask_storeu(dist + b, tail, acc);
+        if ((b & 63) == 0)
+            mask[b >> 6] = 0;
+        mask[b >> 6] |= (uint64_t)(ch_avx512_gtz(acc) & tail) << (b & 63);
+    }
+}
+#endif /* CH_SIMD_X86 */
+
+/* Picks the widest visibility kernel that the CPU supports */
+static ch_visibility_kernel select_visibility_kernel(void)
+{
+#ifdef CH_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return visibility_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return visibility_avx2;
+    return visibility_sse2;
+#else
+    return visibility_scalar;
+#endif
+}
+
+static ch_visibility_kernel visibility_kernel(void)
+{
+    static const ch_visibility_kernel kernel = select_visibility_kernel();
+    return kernel;
+}
+
+/* Returns the index of the lowest set bit of the bitmask 'mask' of 'n' bits, or -1 if none are set */
+static int mask_first(const uint64_t *mask, const int n)
+{
+    int w;
+    for (w = 0; w < (n + 63) >> 6; w++)
+        if (mask[w] != 0)
+        {
+#if defined(__GNUC__) || defined(__clang__)
+            return (w << 6) + __builtin_ctzll(mask[w]);
+#else
+            int b;
+            for (b = 0; !((mask[w] >> b) & 1); b++)
+                ;
+            return (w << 6) + b;
+#endif
+        }
+    return -1;
+}
+
+/* Runs fn(arg, t) for t = 0 .. nThreads-1, each on its own thread; the calling thread takes t = 0. If a thread cannot
+ * be started, then its share is run on the calling thread instead (after its own), in the same way that the builds
+ * carry on serially when there is not the memory for the optional parallel scratch buffers. None of the tasks wait on
+ * each other, so they may be run in any order */
+typedef void (*ch_task_fn)(void *arg, const int t);
+
+#ifdef CH_PTHREADS
+typedef struct ch_worker
+{
+    ch_task_fn fn;
+    void *arg;
+    int t;
+} ch_worker;
+
+static void *ch_worker_main(void *worker)
+{
+    ch_worker *w = (ch_worker *)worker;
+    w->fn(w->arg, w->t);
+    return NULL;
+}
+#endif
+
+static void parallel_run(const int nThreads, ch_task_fn fn, void *arg)
+{
+    int started[CH_MAX_THREADS];
+#ifdef CH_PTHREADS
+    ch_worker workers[CH_MAX_THREADS];
+    pthread_t threads[CH_MAX_THREADS];
+#else
+    std::thread threads[CH_MAX_THREADS];
+#endif
+    int t;
+    for (t = 1; t < nThreads; t++)
+    {
+#if defined(CH_PTHREADS)
+        workers[t].fn = fn;
+        workers[t].arg = arg;
+        workers[t].t = t;
+        started[t] = ch_pthread_create(&threads[t], NULL, ch_worker_main, &workers[t]) == 0;
+#elif defined(CH_EXCEPTIONS)
+        try
+        {
+            threads[t] = std::thread(fn, arg, t);
+            started[t] = 1;
+        }
+        catch (...)
+        {
+            started[t] = 0;
+        }
+#else
+        threads[t] = std::thread(fn, arg, t);
+        started[t] = 1;
+#endif
+    }
+    fn(arg, 0);
+    for (t = 1; t < nThreads; t++)
+    {
+        if (!started[t])
+            fn(arg, t);
+#ifdef CH_PTHREADS
+        else
+            pthread_join(threads[t], NULL);
+#else
+        else
+            threads[t].join();
+#endif
+    }
+}
+
+/* Splits [lo, hi) into 'n' contiguous parts, and returns the first index of part 'part' */
+static int split_range(const int lo, const int hi, const int n, const int part)
+{
+    return lo + (int)(((long long)(hi - lo) * part) / n);
+}
+
+/* Shared state of a parallel radix sort pass, see sort_keys() */
+typedef struct radix_task
+{
+    const key_w_idx *src;
+    key_w_idx *dst;
+    int len, nThreads, shift;
+    int count[CH_MAX_THREADS][CH_RADIX_SIZE]; /* digit counts of each thread's part, then its scatter offsets */
+} radix_task;
+
+/* counts the digits in thread t's part */
+static void radix_count(void *arg, const int t)
+{
+    radix_task *task = (radix_task *)arg;
+    int i, lo, hi;
+    lo = split_range(0, task->len, task->nThreads, t);
+    hi = split_range(0, task->len, task->nThreads, t + 1);
+    memset(task->count[t], 0, sizeof(task->count[t]));
+    for (i = lo; i < hi; i++)
+        task->count[t][(task->src[i].val >> task->shift) & (CH_RADIX_SIZE - 1)]++;
+}
+
+/* scatters thread t's part, from its offsets */
+static void radix_scatter(void *arg, const int t)
+{
+    radix_task *task = (radix_task *)arg;
+    int i, lo, hi;
+    lo = split_range(0, task->len, task->nThreads, t);
+    hi = split_range(0, task->len, task->nThreads, t + 1);
+    for (i = lo; i < hi; i++)
+        task->dst[task->count[t][(task->src[i].val >> task->shift) & (CH_RADIX_SIZE - 1)]++] = task->src[i];
+}
+
+/* Sorts keys into ascending order, with a (stable) least significant digit radix sort, in CH_RADIX_BITS digits. The
+ * digits that are the same for all of the keys are skipped, so e.g. keys that fit in 32 bits take at most 4 passes.
+ * With more than CH_RADIX_PAR_MIN keys, each pass is spread over 'nThreads' threads: each thread counts the digits of
+ * its own (contiguous) part, and then scatters its part to the offsets that follow those of the threads before it */
+static void sort_keys(key_w_idx *data, /* the keys to sort; len x 1 */
+                      key_w_idx *tmp, /* scratch space; len x 1 */
+                      const int len, /* number of keys */
+                      const int nThreads) /* number of threads */
+{
+    int i, t, b, shift, sum, nPar;
+    int count[CH_RADIX_SIZE];
+    uint64_t diff;
+    key_w_idx *src, *dst, *swap;
+    radix_task *task;
+
+    if (len < 2)
+        return;
+    nPar = len >= CH_RADIX_PAR_MIN ? MAX(MIN(nThreads, CH_MAX_THREADS), 1) : 1;
+    task = nPar > 1 ? (radix_task *)ch_malloc(sizeof(radix_task)) : NULL; /* (single-threaded, if it cannot be had) */
+    if (task != NULL)
+    {
+        task->len = len;
+        task->nThreads = nPar;
+    }
+    for (i = 1, diff = 0; i < len; i++)
+        diff |= data[i].val ^ data[0].val;
+    src = data;
+    dst = tmp;
+    for (shift = 0; shift < 64; shift += CH_RADIX_BITS)
+    {
+        if (((diff >> shift) & (CH_RADIX_SIZE - 1)) == 0)
+            continue;
+        if (task == NULL)
+        {
+            memset(count, 0, sizeof(count));
+            for (i = 0; i < len; i++)
+                count[(src[i].val >> shift) & (CH_RADIX_SIZE - 1)]++;
+            for (b = 0, sum = 0; b < CH_RADIX_SIZE; b++)
+            {
+                i = count[b];
+                count[b] = sum;
+                sum += i;
+            }
+            for (i = 0; i < len; i++)
+                dst[count[(src[i].val >> shift) & (CH_RADIX_SIZE - 1)]++] = src[i];
+        }
+        else
+        {
+            task->src = src;
+            task->dst = dst;
+            task->shift = shift;
+            parallel_run(nPar, radix_count, task);
+            for (b = 0, sum = 0; b < CH_RADIX_SIZE; b++)
+            {
+                for (t = 0; t < nPar; t++)
+                {
+                    i = task->count[t][b];
+                    task->count[t][b] = sum;
+                    sum += i;
+                }
+            }
+            parallel_run(nPar, radix_scatter, task);
+        }
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+    if (src != data)
+        memcpy(data, src, size_t(len) * sizeof(key_w_idx));
+    ch_free(task);
+}
+
+/* Directions of the k-DOP (discrete oriented polytope), without their opposites; the first 3 give the 6-DOP, the first
+ * 7 the 14-DOP, and all 13 the 26-DOP */
+static const CH_FLOAT kdop_axes[CH_KDOP_MAX_AXES][3] = {
+    { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },                                    /* faces of a cube */
+    { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { 1, -1, -1 },                   /* corners */
+    { 1, 1, 0 }, { 1, -1, 0 }, { 1, 0, 1 }, { 1, 0, -1 }, { 0, 1, 1 }, { 0, 1, -1 } /* edges */
+};
+
+/* Shared state of the k-DOP culling pass, see kdop_cull() */
+typedef struct kdop_task
+{
+    const CH_FLOAT *points; /* flat: nVert x stride */
+    int stride, nVert, nThreads, nAxes;
+    CH_FLOAT axes[4 * CH_KDOP_MAX_AXES]; /* directions, as planes (see ch_planes) through the origin; ld = nAxes */
+    CH_FLOAT ext_max[CH_MAX_THREADS][CH_KDOP_MAX_AXES], ext_min[CH_MAX_THREADS][CH_KDOP_MAX_AXES];
+    int arg_max[CH_MAX_THREADS][CH_KDOP_MAX_AXES], arg_min[CH_MAX_THREADS][CH_KDOP_MAX_AXES];
+    const ch_planes *kdop; /* planes of the polytope spanned by the extreme points */
+    int nPlanes;
+    int *keep; /* 0 for the points strictly inside the polytope, 1 otherwise */
+    ch_visibility_kernel visibility;
+} kdop_task;
+
+/* Finds the extreme points along each direction, over thread t's share of the points */
+static void kdop_extremes(void *arg, const int t)
+{
+    kdop_task *task = (kdop_task *)arg;
+    int i, a, lo, hi;
+    CH_FLOAT dist[CH_KDOP_MAX_AXES];
+    uint64_t mask[1];
+
+    lo = split_range(0, task->nVert, task->nThreads, t);
+    hi = split_range(0, task->nVert, task->nThreads, t + 1);
+    for (a = 0; a < task->nAxes; a++)
+    {
+        task->ext_max[t][a] = -CH_FLT_MAX;
+        task->ext_min[t][a] = CH_FLT_MAX;
+        task->arg_max[t][a] = task->arg_min[t][a] = -1;
+    }
+    for (i = lo; i < hi; i++)
+    {
+        task->visibility(3, task->axes, task->nAxes, &task->points[i * task->stride], 0, task->nAxes, dist, mask);
+        for (a = 0; a < task->nAxes; a++)
+        {
+            if (dist[a] > task->ext_max[t][a])
+            {
+                task->ext_max[t][a] = dist[a];
+                task->arg_max[t][a] = i;
+            }
+            if (dist[a] < task->ext_min[t][a])
+            {
+                task->ext_min[t][a] = dist[a];
+                task->arg_min[t][a] = i;
+            }
+        }
+    }
+}
+
+/* Flags the points that are strictly inside the polytope, over thread t's share of the points. The polytope planes
+ * are offset outwards by the tolerance, so a point is kept as soon as the kernel finds any "visible" plane */
+static void kdop_classify(void *arg, const int t)
+{
+    kdop_task *task = (kdop_task *)arg;
+    int i, f, lo, hi;
+    CH_FLOAT dist[64];
+    uint64_t mask[1];
+
+    lo = split_range(0, task->nVert, task->nThreads, t);
+    hi = split_range(0, task->nVert, task->nThreads, t + 1);
+    for (i = lo; i < hi; i++)
+    {
+        task->keep[i] = 0;
+        for (f = 0; f < task->nPlanes; f += 64)
+        {
+            task->visibility(3, task->kdop->data, task->kdop->ld, &task->points[i * task->stride], f,
+                             MIN(f + 64, task->nPlanes), dist, mask);
+            if (mask[0] != 0)
+            {
+                task->keep[i] = 1;
+                break;
+            }
+        }
+    }
+}
+
+/* Akl-Toussaint heuristic: finds the extreme points along 'nDirections' (6, 14 or 26) directions, and writes the
+ * indices of the points that are not strictly inside the polytope spanned by them to 'survivors'. Such interior points
+ * cannot be vertices of the hull. 'keep' is scratch space for nVert flags. Returns the number of survivors */
+static int kdop_cull(kdop_task *task, ch_planes *kdop, const CH_FLOAT *points, const int stride, const int nVert,
+                     const int nDirections, const int nThreads, int *keep, int *survivors)
+{
+    CH_FLOAT *pl;
+    const CH_FLOAT *pa, *pb, *pc;
+    CH_FLOAT n[3], e1[3], e2[3], off, norm, dist, dmin, dmax, maxabs, tol;
+    int ext[2 * CH_KDOP_MAX_AXES];
+    int i, j, k, a, t, m, f, nSurvivors, ld, dup;
+
+    task->points = points;
+    task->stride = stride;
+    task->nVert = nVert;
+    task->nThreads = MAX(1, MIN(nThreads, CH_MAX_THREADS));
+    task->nAxes = nDirections >= 26 ? 13 : (nDirections >= 14 ? 7 : 3);
+    task->visibility = visibility_kernel();
+    for (a = 0; a < task->nAxes; a++)
+    {
+        for (k = 0; k < 3; k++)
+            task->axes[k * task->nAxes + a] = kdop_axes[a][k];
+        task->axes[3 * task->nAxes + a] = 0.0;
+    }
+    parallel_run(task->nThreads, kdop_extremes, task);
+
+    /* The distinct extreme points over all threads */
+    m = 0;
+    for (a = 0; a < task->nAxes; a++)
+    {
+        for (j = 0, t = 0; t < task->nThreads; t++)
+            if (task->arg_max[t][a] != -1 && task->ext_max[t][a] > task->ext_max[j][a])
+                j = t;
+        ext[m++] = task->arg_max[j][a];
+        for (j = 0, t = 0; t < task->nThreads; t++)
+            if (task->arg_min[t][a] != -1 && task->ext_min[t][a] < task->ext_min[j][a])
+                j = t;
+        ext[m++] = task->arg_min[j][a];
+    }
+    for (i = 0, k = 0; i < m; i++)
+    {
+        for (j = 0; j < k; j++)
+            if (ext[j] == ext[i])
+                break;
+        if (j == k)
+            ext[k++] = ext[i];
+    }
+    m = k;
+
+    /* Planes of the polytope: every plane through 3 of the extreme points that has all of the others on one side */
+    maxabs = 0.0;
+    for (i = 0; i < m; i++)
+        for (k = 0; k < 3; k++)
+            maxabs = MAX(maxabs, fabs(points[ext[i] * stride + k]));
+    tol = CH_KDOP_TOL * maxabs;
+    if (!planes_reserve(kdop, 3, 0, m * (m - 1) * (m - 2) / 6))
+        m = 0; /* out of memory; so no points are culled */
+    pl = kdop->data;
+    ld = kdop->ld;
+    task->nPlanes = 0;
+    for (i = 0; i < m; i++)
+    {
+        for (j = i + 1; j < m; j++)
+        {
+            for (k = j + 1; k < m; k++)
+            {
+                pa = &points[ext[i] * stride];
+                pb = &points[ext[j] * stride];
+                pc = &points[ext[k] * stride];
+                for (a = 0; a < 3; a++)
+                {
+                    e1[a] = pb[a] - pa[a];
+                    e2[a] = pc[a] - pa[a];
+                }
+                n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+                n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+                n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+                norm = ch_sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (norm <= tol * tol)
+                    continue; /* the 3 points are (nearly) collinear */
+                for (a = 0; a < 3; a++)
+                    n[a] /= norm;
+                off = -(n[0] * pa[0] + n[1] * pa[1] + n[2] * pa[2]);
+                dmin = dmax = 0.0;
+                for (a = 0; a < m; a++)
+                {
+                    dist = n[0] * points[ext[a] * stride] + n[1] * points[ext[a] * stride + 1] +
+                           n[2] * points[ext[a] * stride + 2] + off;
+                    dmin = MIN(dmin, dist);
+                    dmax = MAX(dmax, dist);
+                }
+                if (dmin < -tol && dmax > tol)
+                    continue; /* extreme points on both sides */
+                if (dmin >= -tol && dmax <= tol)
+                    continue; /* all of the extreme points are on this plane */
+                if (dmax > tol)
+                {
+                    /* flip, so that the extreme points are below the plane */
+                    for (a = 0; a < 3; a++)
+                        n[a] = -n[a];
+                    off = -off;
+                }
+
+                /* Skip planes that have already been found (through another 3 of its points) */
+                for (f = 0, dup = 0; f < task->nPlanes && !dup; f++)
+                    dup = fabs(pl[f] - n[0]) + fabs(pl[ld + f] - n[1]) + fabs(pl[2 * ld + f] - n[2]) < CH_KDOP_TOL &&
+                          fabs(pl[3 * ld + f] - off - tol) <= tol;
+                if (dup)
+                    continue;
+                for (a = 0; a < 3; a++)
+                    pl[a * ld + task->nPlanes] = n[a];
+                pl[3 * ld + task->nPlanes] = off + tol; /* offset outwards, so that only points strictly inside are culled */
+                task->nPlanes++;
+            }
+        }
+    }
+
+    /* Too few planes to enclose any volume */
+    if (task->nPlanes < 4)
+    {
+        for (i = 0, nSurvivors = 0; i < nVert; i++)
+            survivors[nSurvivors++] = i;
+        return nSurvivors;
+    }
+
+    /* Keep the points that are not strictly inside the polytope */
+    task->kdop = kdop;
+    task->keep = keep;
+    parallel_run(task->nThreads, kdop_classify, task);
+    for (i = 0, nSurvivors = 0; i < nVert; i++)
+        if (task->keep[i])
+            survivors[nSurvivors++] = i;
+    return nSurvivors;
+}
+
+/* The interior points of a dynamic hull (see convhull_3d_hull). Each point inside the hull is owned by the face that
+ * the ray from 'centre' (a point strictly inside the hull) through the point leaves the hull by. So when faces are
+ * replaced by others over the same boundary (i.e., a new cone, or the faces that fill the hole left by a removed
+ * vertex), only the points that they owned can change owner; and these are also the only points that can become
+ * vertices when a vertex is removed. The faces of a dynamic hull are never compacted, so that they keep their indices;
+ * deleted faces leave holes in the face slots, which are reused by the new faces */
+typedef struct ch_owners
+{
+    CH_FLOAT centre[3];
+    int nSlots; /* number of face slots in use, including the deleted ones */
+    int nFree; /* number of free slots, on the free list (ffree) of the context */
+    int *fin; /* first point owned by each face, or -1; (per face) */
+    int *inext, *iprev; /* next and previous point owned by the same face, or -1; (per point) */
+    int *iown; /* face that owns each point, or -1 for vertices and for points that are not in the hull; (per point) */
+    int *vface; /* a face of each vertex, or -1 for the other points; (per point) */
+    unsigned int walk; /* state of the random choices of owner_walk() */
+} ch_owners;
+
+/* Scratch buffers used by convhull_3d_build_ctx(). The per-point buffers can hold 'maxVert' points, and the per-face
+ * buffers can hold 'maxFaces' faces; both grow geometrically, and are only ever released by a reset or destroy */
+struct _convhull_3d_context
+{
+    /* per-point buffers */
+    int maxVert;
+    CH_FLOAT *points; /* noisy copy of the input vertices, with a last column of ones; flat: nVert x 4 */
+    CH_FLOAT *reldist; /* relative distance of each point from the center */
+    CH_FLOAT *desReldist; /* sorted relative distances */
+    int *ind; /* points, sorted from maximum to minimum relative distance */
+    int *pnext; /* next point in the same outside set */
+    int *orphans; /* points orphaned by the deletion of visible faces */
+    key_w_idx *sort_ws; /* scratch space for sorting; 2*nVert x 1 */
+    int *cand; /* candidate points, i.e. those that survived the k-DOP culling */
+    int *order; /* input index of each point, when the points are copied in insertion order */
+    key_w_idx *order_ws; /* scratch space for the insertion order; 2*nVert x 1 */
+
+    /* per-face buffers */
+    int maxFaces;
+    int *faces; /* face indices, also returned as the output; flat: nFaces x 3 */
+    int *fnbr; /* face neighbours; flat: nFaces x 3 */
+    ch_planes planes; /* plane coefficients and constant terms of the faces */
+    CH_FLOAT *fdist; /* distances of a point from a range of faces, from the visibility kernel */
+    uint64_t *fmask; /* bitmask of the faces that are visible from a point, from the visibility kernel */
+    int *fhead; /* first point of the outside set of each face */
+    int *ffar; /* farthest point of the outside set of each face */
+    CH_FLOAT *ffar_dist; /* distance of ffar from the face */
+    int *visible_ind; /* 1: visible, 2: nonvisible but next to a visible face, 0: otherwise */
+    int *visible; /* visible faces */
+    int *fremap; /* new index of each face after the deleted faces have been compacted */
+    int *ffree; /* slots of the deleted faces, which are reused by the new faces */
+    int *pending; /* stack of the faces with non-empty outside sets */
+    int *newf; /* the faces of the new cone */
+    ch_planes cone; /* plane coefficients of the new cone faces, gathered for the visibility kernel */
+    int *horizon; /* horizon edges; flat: nFaces*3 x 2 */
+    int *hz_face; /* face on the other side of each horizon edge */
+    int *hz_slot; /* slot of the neighbour link in hz_face that points back over the edge */
+    ridge_key *keys; /* for linking the new faces; nFaces*2 x 1 */
+    ch_owners *owners; /* the interior points of a dynamic hull, or NULL; see convhull_3d_hull */
+
+    /* k-DOP culling */
+    kdop_task *kdop_ws; /* allocated on first use */
+    ch_planes kdop; /* planes of the k-DOP polytope */
+
+    /* parallel builds, see convhull_3d_build_parallel() */
+    int maxParVert;
+    ch_vertex *par_points; /* noisy copy of the input vertices */
+    ch_vertex *par_union; /* vertices of the sub-hulls */
+    int *par_ind; /* input index of each vertex in par_union */
+    int *par_mark; /* 1 for the points that are vertices of the hull of their chunk */
+    convhull_3d_context *workers[CH_MAX_THREADS]; /* one context per thread; created on first use */
+
+    /* batch builds, see convhull_3d_build_batch() */
+    int maxBatch;
+    int *batch_order; /* items, sorted from largest to smallest */
+
+    /* time-budgeted builds */
+    double deadline; /* ch_clock() time at which the build is to stop, or 0 for none */
+    int nUnprocessed; /* points left unprocessed by a build that was stopped */
+};
+
+/* Makes sure that the per-point buffers of 'ctx' can hold at least 'nVert' points. Returns 0 if the memory cannot be
+ * had; in which case the buffers that did grow are kept, but the capacity is left as it was */
+static int ctx_reserve_points(convhull_3d_context *ctx, const int nVert)
+{
+    int ok;
+    size_t n;
+    if (nVert <= ctx->maxVert)
+        return 1;
+    n = size_t(MAX(nVert, 2 * ctx->maxVert));
+    ok = ch_grow(&ctx->points, n * 4);
+    ok = ok && ch_grow(&ctx->reldist, n);
+    ok = ok && ch_grow(&ctx->desReldist, n);
+    ok = ok && ch_grow(&ctx->ind, n);
+    ok = ok && ch_grow(&ctx->pnext, n);
+    ok = ok && ch_grow(&ctx->orphans, n);
+    ok = ok && ch_grow(&ctx->sort_ws, n * 2);
+    ok = ok && ch_grow(&ctx->cand, n);
+    ok = ok && ch_grow(&ctx->order, n);
+    ok = ok && ch_grow(&ctx->order_ws, n * 2);
+    if (ok)
+        ctx->maxVert = int(n);
+    return ok;
+}
+
+/* Makes sure that the per-face buffers of 'ctx' can hold at least 'nFaces' faces. The contents of the buffers are
+ * preserved, except for 'visible_ind' which is zeroed beyond the old capacity. Returns 0 if the memory cannot be had
+ * (see ctx_reserve_points()) */
+static int ctx_reserve_faces(convhull_3d_context *ctx, const int nFaces)
+{
+    int ok;
+    size_t n;
+    if (nFaces <= ctx->maxFaces)
+        return 1;
+    n = size_t(MAX(nFaces, 2 * ctx->maxFaces));
+    ok = ch_grow(&ctx->faces, n * 3);
+    ok = ok && ch_grow(&ctx->fnbr, n * 3);
+    ok = ok && planes_reserve(&ctx->planes, 3, ctx->maxFaces, int(n));
+    ok = ok && ch_grow(&ctx->fdist, n);
+    ok = ok && ch_grow(&ctx->fmask, (n + 63) / 64);
+    ok = ok && ch_grow(&ctx->fhead, n);
+    ok = ok && ch_grow(&ctx->ffar, n);
+    ok = ok && ch_grow(&ctx->ffar_dist, n);
+    ok = ok && ch_grow(&ctx->visible_ind, n);
+    ok = ok && ch_grow(&ctx->visible, n);
+    ok = ok && ch_grow(&ctx->fremap, n);
+    ok = ok && ch_grow(&ctx->ffree, n);
+    ok = ok && ch_grow(&ctx->pending, n);
+    ok = ok && ch_grow(&ctx->newf, n * 3);
+    ok = ok && planes_reserve(&ctx->cone, 3, 0, int(n));
+    ok = ok && ch_grow(&ctx->horizon, n * 3 * 2);
+    ok = ok && ch_grow(&ctx->hz_face, n * 3);
+    ok = ok && ch_grow(&ctx->hz_slot, n * 3);
+    ok = ok && ch_grow(&ctx->keys, n * 2);
+    ok = ok && (ctx->owners == NULL || ch_grow(&ctx->owners->fin, n));
+    if (!ok)
+        return 0;
+    memset(ctx->visible_ind + ctx->maxFaces, 0, (n - size_t(ctx->maxFaces)) * sizeof(int));
+    ctx->maxFaces = int(n);
+    return 1;
+}
+
+/* Monotonic time, in seconds */
+static double ch_clock(void)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Starts the clock of a build on 'ctx', for its time budget (if any) */
+static void ctx_start_clock(convhull_3d_context *ctx, const convhull_3d_options *options)
+{
+    ctx->deadline = options->time_budget > 0.0 ? ch_clock() + options->time_budget : 0.0;
+    ctx->nUnprocessed = 0;
+}
+
+/* 1 if a build is to stop, as it has run past its deadline (if any; see ch_clock()) or has been cancelled */
+static int ch_stopped(const double deadline, const convhull_3d_options *options)
+{
+    if (options->cancel != NULL && options->cancel->load(std::memory_order_relaxed) != 0)
+        return 1;
+    return deadline > 0.0 && ch_clock() >= deadline;
+}
+
+convhull_3d_context *convhull_3d_context_create(void)
+{
+    return (convhull_3d_context *)ch_calloc(1, sizeof(convhull_3d_context));
+}
+
+void convhull_3d_context_reset(convhull_3d_context *ctx)
+{
+    int i;
+
+    ch_free(ctx->points);
+    ch_free(ctx->reldist);
+    ch_free(ctx->desReldist);
+    ch_free(ctx->ind);
+    ch_free(ctx->pnext);
+    ch_free(ctx->orphans);
+    ch_free(ctx->sort_ws);
+    ch_free(ctx->cand);
+    ch_free(ctx->order);
+    ch_free(ctx->order_ws);
+    ch_free(ctx->faces);
+    ch_free(ctx->fnbr);
+    planes_free(&ctx->planes);
+    ch_free(ctx->fdist);
+    ch_free(ctx->fmask);
+    ch_free(ctx->fhead);
+    ch_free(ctx->ffar);
+    ch_free(ctx->ffar_dist);
+    ch_free(ctx->visible_ind);
+    ch_free(ctx->visible);
+    ch_free(ctx->fremap);
+    ch_free(ctx->ffree);
+    ch_free(ctx->pending);
+    ch_free(ctx->newf);
+    planes_free(&ctx->cone);
+    ch_free(ctx->horizon);
+    ch_free(ctx->hz_face);
+    ch_free(ctx->hz_slot);
+    ch_free(ctx->keys);
+    ch_free(ctx->kdop_ws);
+    planes_free(&ctx->kdop);
+    ch_free(ctx->par_points);
+    ch_free(ctx->par_union);
+    ch_free(ctx->par_ind);
+    ch_free(ctx->par_mark);
+    ch_free(ctx->batch_order);
+    for (i = 0; i < CH_MAX_THREADS; i++)
+        convhull_3d_context_destroy(ctx->workers[i]);
+    memset(ctx, 0, sizeof(convhull_3d_context));
+}
+
+void convhull_3d_context_destroy(convhull_3d_context *ctx)
+{
+    if (ctx == NULL)
+        return;
+    convhull_3d_context_reset(ctx);
+    ch_free(ctx);
+}
+
+/* Sign of the orientation of point p relative to a face; positive if p is below the face, i.e. on the side that its
+ * normal points away from. If 'exact', then exact predicates are used; otherwise the determinant is evaluated in
+ * floating point, which requires the points to have a last column of ones (i.e. stride 4) */
+static int face_orient(const CH_FLOAT *points, const int stride, const int *face, const int p, const int exact)
+{
+    CH_FLOAT A[16], det;
+    int i, j;
+
+    if (exact)
+        return orient3d(&points[face[0] * stride], &points[face[1] * stride], &points[face[2] * stride],
+                        &points[p * stride]);
+    for (i = 0; i < 3; i++)
+        for (j = 0; j < 4; j++)
+            A[i * 4 + j] = points[face[i] * stride + j];
+    for (j = 0; j < 4; j++)
+        A[12 + j] = points[p * stride + j];
+    det = det_4x4(A);
+    return det > 0.0 ? 1 : (det < 0.0 ? -1 : 0);
+}
+
+/* Finds the first of the faces flist[0..n) that point p is strictly above, using exact predicates. Returns the face
+ * (and the floating point distance of p from it), or -1 if there is none */
+static int first_visible_exact(const CH_FLOAT *points, const int stride, const int *faces, const CH_FLOAT *pl,
+                               const int ld, const int *flist, const int n, const int p, CH_FLOAT *dist)
+{
+    int f, i, k;
+
+    for (i = 0; i < n; i++)
+    {
+        f = flist[i];
+        if (face_orient(points, stride, &faces[f * 3], p, 1) < 0)
+        {
+            (*dist) = pl[3 * ld + f];
+            for (k = 0; k < 3; k++)
+                (*dist) += points[p * stride + k] * pl[k * ld + f];
+            return f;
+        }
+    }
+    return -1;
+}
+
+/* Pushes face f, whose outside set has just become non-empty, onto the stack of faces that are still to be processed.
+ * The stack may also hold faces that have since been deleted (or whose slots have been reused), which are skipped when
+ * popped; so if it is full, it is rebuilt from the faces that have non-empty outside sets instead (which include f) */
+static void push_pending(int *pending, int *nPending, const int maxPending, const int *fhead, const int nSlots,
+                         const int f)
+{
+    int j;
+    if ((*nPending) < maxPending)
+    {
+        pending[(*nPending)++] = f;
+        return;
+    }
+    for (j = 0, (*nPending) = 0; j < nSlots; j++)
+        if (fhead[j] != -1)
+            pending[(*nPending)++] = j;
+}
+
+/* Adds point p to the points owned by face f */
+static void own_point(ch_owners *ow, const int p, const int f)
+{
+    ow->iown[p] = f;
+    ow->iprev[p] = -1;
+    ow->inext[p] = ow->fin[f];
+    if (ow->fin[f] != -1)
+        ow->iprev[ow->fin[f]] = p;
+    ow->fin[f] = p;
+}
+
+/* Removes point p from the points owned by its face, if it has one */
+static void disown_point(ch_owners *ow, const int p)
+{
+    int f;
+    f = ow->iown[p];
+    if (f == -1)
+        return;
+    if (ow->iprev[p] != -1)
+        ow->inext[ow->iprev[p]] = ow->inext[p];
+    else
+        ow->fin[f] = ow->inext[p];
+    if (ow->inext[p] != -1)
+        ow->iprev[ow->inext[p]] = ow->iprev[p];
+    ow->iown[p] = -1;
+}
+
+/* Finds the face that should own point p (see ch_owners), by walking over the faces from face f. The ray from the
+ * centre through p passes through face f if p is on the inner side of the three planes through the centre and the
+ * edges of f; otherwise, the walk crosses one of the edges that p is beyond (picked at random, so that it cannot go
+ * round in circles). The walk is given up, in favour of testing every face, if it takes too long */
+static int owner_walk(ch_owners *ow, const CH_FLOAT *points, const int ps, const int *faces, const int *fnbr,
+                      const int nSlots, int f, const int p)
+{
+    int k, t, s, g, prev, steps;
+    const CH_FLOAT *c, *x;
+
+    c = ow->centre;
+    x = &points[p * ps];
+    prev = -1;
+    for (steps = 0; steps < 4 * nSlots + 64; steps++)
+    {
+        ow->walk = ow->walk * 1103515245u + 12345u;
+        s = int((ow->walk >> 16) % 3);
+        for (t = 0, g = -1; t < 3; t++)
+        {
+            k = (s + t) % 3;
+            if (fnbr[f * 3 + k] == prev)
+                continue; /* p is on the inner side of the edge that the walk came over */
+            if (orient3d(c, &points[faces[f * 3 + (k + 1) % 3] * ps], &points[faces[f * 3 + (k + 2) % 3] * ps], x) > 0)
+            {
+                g = fnbr[f * 3 + k];
+                break;
+            }
+        }
+        if (g == -1)
+            return f;
+        prev = f;
+        f = g;
+    }
+    for (f = 0, g = -1; f < nSlots; f++)
+    {
+        if (faces[f * 3] == -1)
+            continue;
+        g = f;
+        for (k = 0; k < 3; k++)
+            if (orient3d(c, &points[faces[f * 3 + (k + 1) % 3] * ps], &points[faces[f * 3 + (k + 2) % 3] * ps], x) > 0)
+                break;
+        if (k == 3)
+            return f;
+    }
+    return g;
+}
+
+/* Cell of the direction from c to p, on a cube of directions with CH_WALK_GRID x CH_WALK_GRID cells on each of its 6
+ * sides; so that a walk towards p (see owner_walk()) may start from where the last walk in the same direction ended */
+static int direction_cell(const CH_FLOAT *c, const CH_FLOAT *p)
+{
+    CH_FLOAT v[3], m;
+    int a, k, u, w;
+
+    for (k = 0, a = 0; k < 3; k++)
+    {
+        v[k] = p[k] - c[k];
+        if (ch_fabs(v[k]) > ch_fabs(v[a]))
+            a = k;
+    }
+    m = ch_fabs(v[a]);
+    if (m == 0.0)
+        return 0;
+    u = MIN(CH_WALK_GRID - 1, (int)((v[(a + 1) % 3] / m + 1.0) * (CH_FLOAT)(0.5 * CH_WALK_GRID)));
+    w = MIN(CH_WALK_GRID - 1, (int)((v[(a + 2) % 3] / m + 1.0) * (CH_FLOAT)(0.5 * CH_WALK_GRID)));
+    return ((a * 2 + (v[a] > 0.0)) * CH_WALK_GRID + u) * CH_WALK_GRID + w;
+}
+
+/* Picks the (d+1) points of the initial simplex from the extreme points: the pair of min/max points along the axis
+ * with the largest extent, then the point farthest from the line through them, then the point farthest from the plane
+ * through those three, and so on (distances are taken from the residuals of a Gram-Schmidt basis of the simplex so
+ * far). Returns 0 if the points do not span 'd' dimensions */
+static int simplex_extreme(const CH_FLOAT *points, const int stride, const int nVert, const int d, int *simplex)
+{
+    int i, j, k, l, best, lo, hi;
+    CH_FLOAT dist, best_dist, dot;
+    CH_FLOAT basis[CONVHULL_ND_MAX_DIMENSIONS * CONVHULL_ND_MAX_DIMENSIONS], r[CONVHULL_ND_MAX_DIMENSIONS];
+    const CH_FLOAT *o;
+
+    /* The pair of min/max points along the axis with the largest extent */
+    best_dist = -1.0;
+    for (j = 0; j < d; j++)
+    {
+        for (i = 1, lo = 0, hi = 0; i < nVert; i++)
+        {
+            if (points[i * stride + j] < points[lo * stride + j])
+                lo = i;
+            if (points[i * stride + j] > points[hi * stride + j])
+                hi = i;
+        }
+        if (points[hi * stride + j] - points[lo * stride + j] > best_dist)
+        {
+            best_dist = points[hi * stride + j] - points[lo * stride + j];
+            simplex[0] = lo;
+            simplex[1] = hi;
+        }
+    }
+    if (!(best_dist > 0.0))
+        return 0;
+
+    /* Then, one at a time, the point farthest from the affine hull of the simplex so far */
+    o = &points[simplex[0] * stride];
+    for (k = 1; k < d + 1; k++)
+    {
+        if (k > 1)
+        {
+            best = -1;
+            best_dist = 0.0;
+            for (i = 0; i < nVert; i++)
+            {
+                for (j = 0; j < d; j++)
+                    r[j] = points[i * stride + j] - o[j];
+                for (l = 0; l < k - 1; l++)
+                {
+                    for (j = 0, dot = 0.0; j < d; j++)
+                        dot += r[j] * basis[l * d + j];
+                    for (j = 0; j < d; j++)
+                        r[j] -= dot * basis[l * d + j];
+                }
+                for (j = 0, dist = 0.0; j < d; j++)
+                    dist += r[j] * r[j];
+                if (dist > best_dist)
+                {
+                    best_dist = dist;
+                    best = i;
+                }
+            }
+            if (best == -1)
+                return 0;
+            simplex[k] = best;
+        }
+
+        /* Add the direction to the new point to the basis */
+        if (k == d)
+            break;
+        for (j = 0; j < d; j++)
+            r[j] = points[simplex[k] * stride + j] - o[j];
+        for (l = 0; l < k - 1; l++)
+        {
+            for (j = 0, dot = 0.0; j < d; j++)
+                dot += r[j] * basis[l * d + j];
+            for (j = 0; j < d; j++)
+                r[j] -= dot * basis[l * d + j];
+        }
+        for (j = 0, dist = 0.0; j < d; j++)
+            dist += r[j] * r[j];
+        dist = ch_sqrt(dist);
+        for (j = 0; j < d; j++)
+            basis[(k - 1) * d + j] = r[j] / dist;
+    }
+    return 1;
+}
+
+/* Finds the first 4 points (by index) that span 3 dimensions, using exact predicates. Returns 0 if there are none */
+static int simplex_exact(const CH_FLOAT *points, const int stride, const int nVert, int *simplex)
+{
+    const CH_FLOAT *a, *b, *c;
+    int i, k, found;
+
+    simplex[0] = 0;
+    a = &points[0];
+    for (i = 1, found = 0; i < nVert && !found; i++)
+        for (k = 0; k < 3; k++)
+            found = found || points[i * stride + k] != a[k];
+    if (!found)
+        return 0;
+    simplex[1] = i - 1;
+    b = &points[simplex[1] * stride];
+    for (found = 0; i < nVert && !found; i++)
+    {
+        c = &points[i * stride];
+        found = orient2d_exact(a[0], a[1], b[0], b[1], c[0], c[1]) != 0 ||
+                orient2d_exact(a[1], a[2], b[1], b[2], c[1], c[2]) != 0 ||
+                orient2d_exact(a[2], a[0], b[2], b[0], c[2], c[0]) != 0;
+    }
+    if (!found)
+        return 0;
+    simplex[2] = i - 1;
+    c = &points[simplex[2] * stride];
+    for (found = 0; i < nVert && !found; i++)
+        found = orient3d(a, b, c, &points[i * stride]) != 0;
+    if (!found)
+        return 0;
+    simplex[3] = i - 1;
+    return 1;
+}
+
+/* Assigns each of the points pts[0..n) to the outside set of the first of the faces [0, nFaces) that it lies above
+ * (deleted faces are skipped); the faces are tested in blocks, so that the search stops soon after that face is found.
+ * The faces whose outside sets become non-empty are pushed onto the stack of pending faces (of which there are
+ * nPending). Points that are not above any face are inside the hull, and are discarded for good; or, in a dynamic
+ * hull, given to the face that owns them. Returns the new number of pending faces */
+static int quickhull_3d_assign(convhull_3d_context *ctx, const CH_FLOAT *points, const int ps, const int exact,
+                               const int *pts, const int n, const int nFaces, int nPending)
+{
+    int j, k, p, lo, hi, ld, nLive, hint;
+    CH_FLOAT dist;
+    CH_FLOAT *pl;
+    int *fhead, *ffar, *pnext, *pending;
+    ch_visibility_kernel visibility;
+
+    pl = ctx->planes.data;
+    ld = ctx->planes.ld;
+    fhead = ctx->fhead;
+    ffar = ctx->ffar;
+    pnext = ctx->pnext;
+    pending = ctx->pending;
+    visibility = visibility_kernel();
+    nLive = 0;
+    if (exact)
+        for (j = 0; j < nFaces; j++)
+            if (ctx->faces[j * 3] != -1)
+                ctx->newf[nLive++] = j;
+    hint = -1;
+    for (k = 0; k < n; k++)
+    {
+        p = pts[k];
+        j = -1;
+        dist = 0.0;
+        if (exact)
+            j = first_visible_exact(points, ps, ctx->faces, pl, ld, ctx->newf, nLive, p, &dist);
+        else
+        {
+            for (lo = 0; lo < nFaces && j == -1; lo = hi)
+            {
+                hi = MIN(nFaces, lo + CH_ASSIGN_BLOCK);
+                visibility(3, pl, ld, &points[p * ps], lo, hi, ctx->fdist, ctx->fmask);
+                j = mask_first(ctx->fmask, hi - lo);
+                if (j != -1)
+                {
+                    dist = ctx->fdist[j];
+                    j += lo;
+                }
+            }
+        }
+        if (j != -1)
+        {
+            if (fhead[j] == -1)
+                pending[nPending++] = j;
+            pnext[p] = fhead[j];
+            fhead[j] = p;
+            if (ffar[j] == -1 || dist > ctx->ffar_dist[j])
+            {
+                ctx->ffar_dist[j] = dist;
+                ffar[j] = p;
+            }
+        }
+        else if (ctx->owners != NULL)
+        {
+            for (hint = hint == -1 ? 0 : hint; ctx->faces[hint * 3] == -1; hint++)
+                ;
+            hint = owner_walk(ctx->owners, points, ps, ctx->faces, ctx->fnbr, nFaces, hint, p);
+            own_point(ctx->owners, p, hint);
+        }
+    }
+    return nPending;
+}
+
+/* Expands the hull, whose faces [0, (*nFaces)) are in ctx (with no deleted faces in between), until the outside sets
+ * of all of its faces are empty, or until the build is stopped (see ch_stopped(); CH_CANCELLED is then returned);
+ * the stack of pending faces holds the first nPending faces to be processed. The faces are left compacted in ctx, and
+ * (*nFaces) is updated. In a dynamic hull (ctx->owners), the faces are in the slots
+ * [0, ctx->owners->nSlots) instead, and are left in place; and the points that end up inside the hull are given to
+ * the faces that own them */
+static ch_status quickhull_3d_expand(convhull_3d_context *ctx, const CH_FLOAT *points, const int ps,
+                                     const convhull_3d_options *options, int *nOut_faces, int nPending)
+{
+    const int d = 3;
+    const int exact = options->exact_predicates;
+    int i, j, k, l, h, p, ld, nFaces, num_orphans, num_inside, num_reown, fi, hint;
+    ch_status status;
+    CH_FLOAT dfi, dist;
+    CH_FLOAT cfi[3], p_s[9];
+    CH_FLOAT *pl, *ffar_dist, *fdist;
+    uint64_t *fmask;
+    ch_visibility_kernel visibility;
+    int *faces, *fnbr, *fhead, *ffar, *pnext, *orphans, *newf, *pending;
+
+    nFaces = (*nOut_faces);
+    faces = ctx->faces;
+    fnbr = ctx->fnbr;
+    pl = ctx->planes.data;
+    ld = ctx->planes.ld;
+    fhead = ctx->fhead;
+    ffar = ctx->ffar;
+    ffar_dist = ctx->ffar_dist;
+    pnext = ctx->pnext;
+    orphans = ctx->orphans;
+    fdist = ctx->fdist;
+    fmask = ctx->fmask;
+    visibility = visibility_kernel();
+    newf = ctx->newf;
+    pending = ctx->pending;
+    ch_owners *ow = ctx->owners;
+
+    /* The main loop for the quickhull algorithm. Deleted faces are marked with faces[f*d] == -1, and their slots are
+     * put on a free list (ffree) for the new faces to reuse. So there are nSlots face slots in use, nFaces of which
+     * hold faces of the current hull. The slots are only compacted once fewer than half of them are in use */
+    int *visible_ind, *visible, *horizon, *hz_face, *hz_slot, *fremap, *ffree;
+    CH_FLOAT *cpl;
+    int num_visible_ind, n_newfaces, count, vis, g;
+    int nSlots, nFree, cld;
+    nSlots = ow != NULL ? ow->nSlots : nFaces;
+    nFree = ow != NULL ? ow->nFree : 0;
+    status = CH_OK;
+    while (1)
+    {
+        /* Take the most recent face with a non-empty outside set (so the hull grows around the latest cone, where the
+         * faces and points are still in cache); the hull is complete once there are none left */
+        while (nPending > 0 && fhead[pending[nPending - 1]] == -1)
+            nPending--;
+        if (nPending == 0)
+            break;
+
+        /* Stop here if the build has run out of time, or has been cancelled; the faces are then the hull of the
+         * points taken up so far, and the points still in the outside sets are left unprocessed */
+        if (ch_stopped(ctx->deadline, options))
+        {
+            for (j = 0; j < nSlots; j++)
+                if (faces[j * d] != -1)
+                    for (p = fhead[j]; p != -1; p = pnext[p])
+                        ctx->nUnprocessed++;
+            status = CH_CANCELLED;
+            break;
+        }
+        fi = pending[--nPending];
+
+        /* i is the farthest point above this face, which is therefore a vertex of the final hull */
+        i = ffar[fi];
+
+        /* Find the visible faces, by walking outwards from face fi over the face neighbours. visible_ind is 1 for
+         * visible faces, and 2 for the nonvisible faces that border them */
+        visible_ind = ctx->visible_ind;
+        visible = ctx->visible;
+        num_visible_ind = 0;
+        visible[num_visible_ind++] = fi;
+        visible_ind[fi] = 1;
+        for (j = 0; j < num_visible_ind; j++)
+        {
+            vis = visible[j];
+            for (k = 0; k < d; k++)
+            {
+                g = fnbr[vis * d + k];
+                if (g == -1 || visible_ind[g] != 0)
+                    continue;
+                if (exact)
+                    dist = face_orient(points, ps, &faces[g * d], i, 1) < 0 ? 1.0 : 0.0;
+                else
+                {
+                    dist = pl[d * ld + g];
+                    for (l = 0; l < d; l++)
+                        dist += points[i * ps + l] * pl[l * ld + g];
+                }
+                if (dist > 0.0)
+                {
+                    visible_ind[g] = 1;
+                    visible[num_visible_ind++] = g;
+                }
+                else
+                    visible_ind[g] = 2;
+            }
+        }
+
+        /* The outside sets of the visible faces are orphaned; their points are redistributed to the new faces below */
+        num_orphans = 0;
+        for (j = 0; j < num_visible_ind; j++)
+            for (p = fhead[visible[j]]; p != -1; p = pnext[p])
+                if (p != i)
+                    orphans[num_orphans++] = p;
+
+        /* Create horizon (count is the number of the edges of the horizon). An edge of a visible face is on the
+         * horizon if the face on the other side of it is nonvisible. Each edge is taken in the (counter-clockwise)
+         * direction that it runs around the visible face, so the new face over it, which replaces the visible face,
+         * is oriented outwards by construction */
+        horizon = ctx->horizon;
+        hz_face = ctx->hz_face;
+        hz_slot = ctx->hz_slot;
+        count = 0;
+        for (j = 0; j < num_visible_ind; j++)
+        {
+            vis = visible[j];
+            for (k = 0; k < d; k++)
+            {
+                g = fnbr[vis * d + k];
+                if (g == -1 || visible_ind[g] != 2)
+                    continue;
+                for (h = 0; h < d - 1; h++)
+                    horizon[count * (d - 1) + h] = faces[vis * d + (k + 1 + h) % d];
+                hz_face[count] = g;
+                for (l = 0; l < d; l++)
+                    if (fnbr[g * d + l] == vis)
+                        hz_slot[count] = l;
+                count++;
+            }
+        }
+        for (j = 0; j < num_visible_ind; j++)
+            for (k = 0; k < d; k++)
+                if (fnbr[visible[j] * d + k] != -1 && visible_ind[fnbr[visible[j] * d + k]] == 2)
+                    visible_ind[fnbr[visible[j] * d + k]] = 0;
+
+        /* Make room for the new faces, within the face budget. This is done before anything is deleted, so that if it
+         * fails, then the hull is left as it was (the loop is left as if the build had been stopped, so that a dynamic
+         * hull also keeps its face slots) */
+        n_newfaces = count;
+        if (options->max_faces > 0 && nFaces - num_visible_ind + n_newfaces > options->max_faces)
+            status = CH_ERROR_FACE_BUDGET;
+        else if (nSlots + MAX(n_newfaces - nFree - num_visible_ind, 0) > ctx->maxFaces)
+        {
+            if (!ctx_reserve_faces(ctx, nSlots + n_newfaces - nFree - num_visible_ind))
+                status = CH_ERROR_MEMORY;
+            faces = ctx->faces;
+            fnbr = ctx->fnbr;
+            pl = ctx->planes.data;
+            ld = ctx->planes.ld;
+            fdist = ctx->fdist;
+            fmask = ctx->fmask;
+            fhead = ctx->fhead;
+            ffar = ctx->ffar;
+            ffar_dist = ctx->ffar_dist;
+            visible_ind = ctx->visible_ind;
+            visible = ctx->visible;
+            horizon = ctx->horizon;
+            hz_face = ctx->hz_face;
+            hz_slot = ctx->hz_slot;
+            newf = ctx->newf;
+            pending = ctx->pending;
+        }
+        if (status != CH_OK)
+        {
+            for (j = 0; j < num_visible_ind; j++)
+                visible_ind[visible[j]] = 0;
+            break;
+        }
+
+        /* In a dynamic hull, the points owned by the visible faces are also orphaned, as are the vertices of the
+         * visible faces (whose vface is cleared; those on the horizon get it back from the new faces). These are all
+         * inside the new hull, so they are just given to their new owners below */
+        num_inside = num_reown = num_orphans;
+        if (ow != NULL)
+        {
+            for (j = 0; j < num_visible_ind; j++)
+                for (p = ow->fin[visible[j]]; p != -1; p = ow->inext[p])
+                    orphans[num_reown++] = p;
+            num_inside = num_reown;
+            for (j = 0; j < num_visible_ind; j++)
+            {
+                for (k = 0; k < d; k++)
+                {
+                    p = faces[visible[j] * d + k];
+                    if (ow->vface[p] != -1)
+                    {
+                        ow->vface[p] = -1;
+                        orphans[num_reown++] = p;
+                    }
+                }
+            }
+        }
+
+        /* Delete the visible faces; their slots go on the free list. A deleted face is given a plane that no point can
+         * be above, and its outside set has already been orphaned */
+        ffree = ctx->ffree;
+        for (j = 0; j < num_visible_ind; j++)
+        {
+            vis = visible[j];
+            visible_ind[vis] = 0;
+            faces[vis * d] = -1;
+            fhead[vis] = ffar[vis] = -1;
+            for (k = 0; k < d; k++)
+                pl[k * ld + vis] = 0.0;
+            pl[d * ld + vis] = -1.0;
+            ffree[nFree++] = vis;
+            if (ow != NULL)
+                ow->fin[vis] = -1;
+        }
+        nFaces = nFaces - num_visible_ind;
+
+        /* Add faces connecting horizon to the new point, in the free slots first */
+        cpl = ctx->cone.data;
+        cld = ctx->cone.ld;
+        for (j = 0; j < n_newfaces; j++)
+        {
+            g = nFree > 0 ? ffree[--nFree] : nSlots++;
+            newf[j] = g;
+            nFaces++;
+            for (k = 0; k < d - 1; k++)
+                faces[g * d + k] = horizon[j * (d - 1) + k];
+            faces[g * d + (d - 1)] = i;
+            fhead[g] = ffar[g] = -1;
+            ffar_dist[g] = 0.0;
+            if (ow != NULL)
+            {
+                ow->fin[g] = -1;
+                for (k = 0; k < d; k++)
+                    ow->vface[faces[g * d + k]] = g;
+            }
+
+            /* Calculate and store appropriately the plane coefficients of the faces (also gathered into 'cone', so
+             * that the orphans can be tested against the new faces in one sweep) */
+            for (k = 0; k < d; k++)
+                for (l = 0; l < d; l++)
+                    p_s[k * d + l] = points[(faces[g * d + k]) * ps + l];
+            plane_3d(p_s, cfi, &dfi);
+            for (k = 0; k < d; k++)
+                pl[k * ld + g] = cpl[k * cld + j] = cfi[k];
+            pl[d * ld + g] = cpl[d * cld + j] = dfi;
+        }
+
+        /* Connect the new faces to each other, and to the faces on the other side of the horizon */
+        link_cone(d, faces, fnbr, newf, n_newfaces, i, hz_face, hz_slot, ctx->keys);
+
+        /* Redistribute the orphaned points, but only to the new faces. Any point that cannot see one of the new
+         * faces is now inside the hull; and, in a dynamic hull, owned by one of the new faces (as the rays that leave
+         * the hull through the visible faces now leave it through the new ones) */
+        hint = newf[0];
+        for (k = 0; k < num_orphans; k++)
+        {
+            p = orphans[k];
+            if (exact)
+                j = first_visible_exact(points, ps, faces, pl, ld, newf, n_newfaces, p, &dist);
+            else
+            {
+                visibility(d, cpl, cld, &points[p * ps], 0, n_newfaces, fdist, fmask);
+                j = mask_first(fmask, n_newfaces);
+                dist = j == -1 ? 0.0 : fdist[j];
+                j = j == -1 ? -1 : newf[j];
+            }
+            if (j != -1)
+            {
+                if (fhead[j] == -1)
+                    push_pending(pending, &nPending, ctx->maxFaces, fhead, nSlots, j);
+                pnext[p] = fhead[j];
+                fhead[j] = p;
+                if (ffar[j] == -1 || dist > ffar_dist[j])
+                {
+                    ffar_dist[j] = dist;
+                    ffar[j] = p;
+                }
+            }
+            else if (ow != NULL)
+            {
+                hint = owner_walk(ow, points, ps, faces, fnbr, nSlots, hint, p);
+                own_point(ow, p, hint);
+            }
+        }
+        for (k = num_orphans; k < num_reown; k++)
+        {
+            p = orphans[k];
+            if (k >= num_inside && ow->vface[p] != -1)
+                continue; /* still a vertex */
+            hint = owner_walk(ow, points, ps, faces, fnbr, nSlots, hint, p);
+            own_point(ow, p, hint);
+        }
+
+        /* Compact the face slots, once fewer than half of them are in use (but never in a dynamic hull) */
+        if (ow == NULL && nFaces < nSlots / 2)
+        {
+            fremap = ctx->fremap;
+            l = nSlots;
+            nSlots = compact_faces(d, nSlots, faces, fnbr, pl, ld, fremap);
+            for (j = 0; j < l; j++)
+            {
+                if (fremap[j] != -1)
+                {
+                    fhead[fremap[j]] = fhead[j];
+                    ffar[fremap[j]] = ffar[j];
+                    ffar_dist[fremap[j]] = ffar_dist[j];
+                }
+            }
+            nFree = 0;
+            for (j = 0, nPending = 0; j < nSlots; j++)
+                if (fhead[j] != -1)
+                    pending[nPending++] = j;
+        }
+    }
+
+    /* Remove any remaining deleted faces */
+    if (ow != NULL)
+    {
+        ow->nSlots = nSlots;
+        ow->nFree = nFree;
+    }
+    else if (nSlots != nFaces)
+        compact_faces(d, nSlots, faces, fnbr, pl, ld, ctx->fremap);
+    (*nOut_faces) = nFaces;
+    return status;
+}
+
+/* A C version of the 3D quickhull matlab implementation from here:
+ * https://www.mathworks.com/matlabcentral/fileexchange/48509-computational-geometry-toolbox?focused=3851550&tab=example
+ * Builds the hull of the points (with a stride of ps, which have already been copied and jittered as need be) into
+ * ctx; with 'ordered', they are taken up in the order that they are in, rather than by their distance from the centre.
+ * Original Copyright (c) 2014, George Papazafeiropoulos
+ * Distributed under the BSD (2-clause) license
+ * Reference: "The Quickhull Algorithm for Convex Hull, C. Bradford Barber, David P. Dobkin
+ *             and Hannu Huhdanpaa, Geometry Center Technical Report GCG53, July 30, 1993"
+ */
+static ch_status quickhull_3d(convhull_3d_context *ctx, const CH_FLOAT *points, const int ps, const int nVert,
+                              const convhull_3d_options *options, const int ordered, int *nOut_faces)
+{
+    const int d = 3;
+    const int exact = options->exact_predicates;
+    int i, j, k, l, p, ld, nFaces;
+    int aVec[4], simplex[4];
+    CH_FLOAT dfi, max_p, min_p;
+    CH_FLOAT span[3], cfi[3], p_s[9], meanp[3];
+    CH_FLOAT *reldist, *pl;
+    int *faces, *fnbr;
+
+    /* Find the span */
+    for (j = 0; j < d; j++)
+    {
+        max_p = -2.23e+13;
+        min_p = 2.23e+13;
+        for (i = 0; i < nVert; i++)
+        {
+            max_p = MAX(max_p, points[i * ps + j]);
+            min_p = MIN(min_p, points[i * ps + j]);
+        }
+        span[j] = max_p - min_p;
+        /* If you hit this assertion error, then the input vertices do not span all 3 dimensions. Therefore the convex hull cannot be built.
+         * In these cases, reduce the dimensionality of the points and call convhull_nd_build() instead with d<3 */
+        if (span[j] < 0.0000001f)
+            return CH_ERROR_DEGENERATE;
+    }
+
+    /* The initial convex hull is a simplex with (d+1) facets, where d is the number of dimensions. Its vertices are
+     * taken from the extreme points, so that it starts off with a large volume. With exact predicates, if these
+     * turn out to be (exactly) coplanar, then the first (d+1) points that are not coplanar are taken instead */
+    if (!simplex_extreme(points, ps, nVert, d, simplex))
+    {
+        if (!exact)
+            return CH_ERROR_DEGENERATE;
+        simplex[0] = simplex[1] = simplex[2] = simplex[3] = 0;
+    }
+    if (exact && orient3d(&points[simplex[0] * ps], &points[simplex[1] * ps], &points[simplex[2] * ps],
+                          &points[simplex[3] * ps]) == 0)
+    {
+        if (!simplex_exact(points, ps, nVert, simplex))
+            return CH_ERROR_DEGENERATE;
+    }
+    nFaces = (d + 1);
+    faces = ctx->faces;
+    pl = ctx->planes.data;
+    ld = ctx->planes.ld;
+    for (i = 0; i < nFaces; i++)
+        aVec[i] = simplex[i];
+    for (i = 0; i < nFaces; i++)
     {
         /* Set the indices of the points defining the face  */
         for (j = 0, k = 0; j < (d + 1); j++)
         {
-            if (aVec[j] != i)
+            if (j != i)
             {
                 faces[i * d + k] = aVec[j];
                 k++;
@@ -582,46 +3057,25 @@ void convhull_3d_build(ch_vertex *const in_vertices, const int nVert, int **out_
         /* Calculate and store the plane coefficients of the face */
         for (j = 0; j < d; j++)
             for (k = 0; k < d; k++)
-                p_s[j * d + k] = points[(faces[i * d + j]) * (d + 1) + k];
+                p_s[j * d + k] = points[(faces[i * d + j]) * ps + k];
 
         /* Calculate and store the plane coefficients of the face */
         plane_3d(p_s, cfi, &dfi);
         for (j = 0; j < d; j++)
-            cf[i * d + j] = cfi[j];
-        df[i] = dfi;
+            pl[j * ld + i] = cfi[j];
+        pl[d * ld + i] = dfi;
     }
-    CH_FLOAT *A;
-    int *bVec, *fVec, *asfVec;
     int face_tmp[2];
 
     /* Check to make sure that faces are correctly oriented */
-    bVec = (int *)ch_malloc(4 * sizeof(int));
-    for (i = 0; i < d + 1; i++)
-        bVec[i] = i;
-
-    /* A contains the coordinates of the points forming a simplex */
-    A = (CH_FLOAT *)ch_calloc(size_t(d + 1) * size_t(d + 1), sizeof(CH_FLOAT));
-    fVec = (int *)ch_malloc(size_t(d + 1) * sizeof(int));
-    asfVec = (int *)ch_malloc(size_t(d + 1) * sizeof(int));
     for (k = 0; k < (d + 1); k++)
     {
-        /* Get the point that is not on the current face (point p) */
-        for (i = 0; i < d; i++)
-            fVec[i] = faces[k * d + i];
-        sort_int(fVec, NULL, NULL, d, 0); /* sort accending */
-        p = k;
-        for (i = 0; i < d; i++)
-            for (j = 0; j < (d + 1); j++)
-                A[i * (d + 1) + j] = points[(faces[k * d + i]) * (d + 1) + j];
-        for (; i < (d + 1); i++)
-            for (j = 0; j < (d + 1); j++)
-                A[i * (d + 1) + j] = points[p * (d + 1) + j];
-
-        /* det(A) determines the orientation of the face */
-        v = det_4x4(A);
+        /* The orientation of the point that is not on the current face (point p) determines the orientation of the
+         * face */
+        p = simplex[k];
 
         /* Orient so that each point on the original simplex can't see the opposite face */
-        if (v < 0)
+        if (face_orient(points, ps, &faces[k * d], p, exact) < 0)
         {
             /* Reverse the order of the last two vertices to change the volume */
             for (j = 0; j < 2; j++)
@@ -630,379 +3084,1281 @@ void convhull_3d_build(ch_vertex *const in_vertices, const int nVert, int **out_
                 faces[k * d + d - j - 1] = face_tmp[1 - j];
 
             /* Modify the plane coefficients of the properly oriented faces */
-            for (j = 0; j < d; j++)
-                cf[k * d + j] = -cf[k * d + j];
-            df[k] = -df[k];
-            for (i = 0; i < d; i++)
-                for (j = 0; j < (d + 1); j++)
-                    A[i * (d + 1) + j] = points[(faces[k * d + i]) * (d + 1) + j];
-            for (; i < (d + 1); i++)
-                for (j = 0; j < (d + 1); j++)
-                    A[i * (d + 1) + j] = points[p * (d + 1) + j];
+            for (j = 0; j < d + 1; j++)
+                pl[j * ld + k] = -pl[j * ld + k];
         }
     }
 
+    /* Face neighbours of the initial simplex. Face k is made up of all of the points except simplex[k], so the face
+     * opposite to its j'th vertex is the face that the vertex is missing from */
+    fnbr = ctx->fnbr;
+    for (k = 0; k < nFaces * d; k++)
+        for (j = 0; j < d + 1; j++)
+            if (simplex[j] == faces[k])
+                fnbr[k] = j;
+
     /* Coordinates of the center of the point set */
-    CH_FLOAT *meanp, *absdist, *reldist, *desReldist;
-    meanp = (CH_FLOAT *)ch_calloc(size_t(d), sizeof(CH_FLOAT));
-    for (i = d + 1; i < nVert; i++)
+    for (j = 0; j < d; j++)
+        meanp[j] = 0.0;
+    for (i = 0; i < nVert; i++)
+    {
+        if (i == simplex[0] || i == simplex[1] || i == simplex[2] || i == simplex[3])
+            continue;
         for (j = 0; j < d; j++)
-            meanp[j] += points[i * (d + 1) + j];
+            meanp[j] += points[i * ps + j];
+    }
     for (j = 0; j < d; j++)
         meanp[j] = meanp[j] / (CH_FLOAT)(nVert - d - 1);
 
-    /* Absolute distance of points from the center */
-    absdist = (CH_FLOAT *)ch_malloc(size_t(nVert - d - 1) * size_t(d) * sizeof(CH_FLOAT));
-    for (i = d + 1, k = 0; i < nVert; i++, k++)
-        for (j = 0; j < d; j++)
-            absdist[k * d + j] = (points[i * (d + 1) + j] - meanp[j]) / span[j];
+    /* The candidate points; i.e., all of the remaining points, except for those that are strictly inside the k-DOP
+     * (which is skipped if there is not the memory for it) */
+    int num_cand, *cand;
+    cand = ctx->cand;
+    if (options->kdop_directions > 0 && ctx->kdop_ws == NULL)
+        ctx->kdop_ws = (kdop_task *)ch_malloc(sizeof(kdop_task));
+    if (options->kdop_directions > 0 && ctx->kdop_ws != NULL)
+    {
+        num_cand = kdop_cull(ctx->kdop_ws, &ctx->kdop, points, ps, nVert, options->kdop_directions,
+                             options->num_threads, ctx->pnext, cand);
+    }
+    else
+    {
+        for (i = 0, num_cand = 0; i < nVert; i++)
+            cand[num_cand++] = i;
+    }
+    for (k = 0, l = 0; k < num_cand; k++)
+        if (cand[k] != simplex[0] && cand[k] != simplex[1] && cand[k] != simplex[2] && cand[k] != simplex[3])
+            cand[l++] = cand[k];
+    num_cand = l;
+
+    /* Initialize the vector of points left. The points with the larger relative distance from the center are assigned
+     first; or, if the points have been copied in insertion order, they are assigned in that order. On large inputs,
+     the culling, the sorting and the assignment each take a while; so the build may also be stopped in between
+     them, with the initial simplex as the hull */
+    int num_pleft;
+    int *pleft;
+    pleft = ctx->ind;
+    num_pleft = num_cand;
+    (*nOut_faces) = nFaces;
+    if (ch_stopped(ctx->deadline, options))
+    {
+        ctx->nUnprocessed += num_cand;
+        return CH_CANCELLED;
+    }
+    if (!ordered)
+    {
+        /* Relative distance of points from the center */
+        reldist = ctx->reldist;
+        for (k = 0; k < num_cand; k++)
+        {
+            reldist[k] = 0.0;
+            for (j = 0; j < d; j++)
+                reldist[k] += ch_pow((points[cand[k] * ps + j] - meanp[j]) / span[j], 2.0);
+        }
 
-    /* Relative distance of points from the center */
-    reldist = (CH_FLOAT *)ch_calloc(size_t(nVert - d - 1), sizeof(CH_FLOAT));
-    desReldist = (CH_FLOAT *)ch_malloc(size_t(nVert - d - 1) * sizeof(CH_FLOAT));
-    for (i = 0; i < (nVert - d - 1); i++)
-        for (j = 0; j < d; j++)
-            reldist[i] += ch_pow(absdist[i * d + j], 2.0);
+        /* Sort from maximum to minimum relative distance */
+        sort_float_ws(reldist, ctx->desReldist, pleft, num_cand, 1, ctx->sort_ws, options->num_threads);
+        for (i = 0; i < num_pleft; i++)
+            pleft[i] = cand[pleft[i]];
+    }
+    else
+    {
+        for (i = 0; i < num_pleft; i++)
+            pleft[i] = cand[i];
+    }
 
-    /* Sort from maximum to minimum relative distance */
-    int num_pleft, cnt;
-    int *ind, *pleft;
-    ind = (int *)ch_malloc(size_t(nVert - d - 1) * sizeof(int));
-    pleft = (int *)ch_malloc(size_t(nVert - d - 1) * sizeof(int));
-    sort_float(reldist, desReldist, ind, (nVert - d - 1), 1);
-
-    /* Initialize the vector of points left. The points with the larger relative
-     distance from the center are scanned first. */
-    num_pleft = (nVert - d - 1);
-    for (i = 0; i < num_pleft; i++)
-        pleft[i] = ind[i] + d + 1;
-
-    /* Loop over all remaining points that are not deleted. Deletion of points
-     occurs every #iter2del# iterations of this while loop */
-    memset(A, 0, size_t((d + 1) * (d + 1)) * sizeof(CH_FLOAT));
-
-    /* cnt is equal to the points having been selected without deletion of
-     nonvisible points (i.e. points inside the current convex hull) */
-    cnt = 0;
-
-    /* The main loop for the quickhull algorithm */
-    CH_FLOAT detA;
-    CH_FLOAT *points_cf, *points_s;
-    int *visible_ind, *visible, *nonvisible_faces, *f0, *face_s, *u, *gVec, *horizon, *hVec, *pp, *hVec_mem_face;
-    int num_visible_ind, num_nonvisible_faces, n_newfaces, count, vis;
-    int f0_sum, u_len, start, num_p, index, horizon_size1;
-    int ERROR;
-    ERROR = 0;
-    u = horizon = NULL;
-    nFaces = d + 1;
-    visible_ind = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-    points_cf = (CH_FLOAT *)ch_malloc(size_t(nFaces) * sizeof(CH_FLOAT));
-    points_s = (CH_FLOAT *)ch_malloc(size_t(d) * sizeof(CH_FLOAT));
-    face_s = (int *)ch_malloc(size_t(d) * sizeof(int));
-    gVec = (int *)ch_malloc(size_t(d) * sizeof(int));
-    while ((num_pleft > 0))
-    {
-        /* i is the first point of the points left */
-        i = pleft[0];
-
-        /* Delete the point selected */
-        for (j = 0; j < num_pleft - 1; j++)
-            pleft[j] = pleft[j + 1];
-        num_pleft--;
-        if (num_pleft == 0)
-            ch_free(pleft);
-        else
-            pleft = (int *)ch_realloc(pleft, size_t(num_pleft) * sizeof(int));
+    /* Outside sets: each face owns a linked list of the points that lie above it (fhead[face] -> pnext[point] -> ...),
+     * along with the farthest of these points (ffar). A point belongs to at most one outside set, and points that are
+     * not above any face are inside the current hull and are discarded for good. */
+    for (j = 0; j < nFaces; j++)
+    {
+        ctx->fhead[j] = ctx->ffar[j] = -1;
+        ctx->ffar_dist[j] = 0.0;
+    }
+    if (ch_stopped(ctx->deadline, options))
+    {
+        ctx->nUnprocessed += num_pleft;
+        return CH_CANCELLED;
+    }
+    return quickhull_3d_expand(ctx, points, ps, options, nOut_faces,
+                               quickhull_3d_assign(ctx, points, ps, exact, pleft, num_pleft, nFaces, 0));
+}
 
-        /* Update point selection counter */
-        cnt++;
+/* Builds the hull of the input vertices: copies them (in insertion order, and with noise unless 'jitter' is 0, i.e.
+ * the caller has already added it), and passes them on to quickhull_3d(). All working memory is taken from 'ctx'.
+ * (*out_faces) points into 'ctx', and is returned as NULL, if triangulation fails */
+static ch_status convhull_3d_build_ws(convhull_3d_context *ctx, ch_vertex *const in_vertices, const int nVert,
+                                      const convhull_3d_options *options, const int jitter, int **out_faces,
+                                      int *nOut_faces)
+{
+    int i, j, p, d, ps, exact, nFaces;
+    ch_status status;
+    CH_FLOAT *points;
+    int *faces, *order;
 
-        /* find visible faces */
-        for (j = 0; j < d; j++)
-            points_s[j] = points[i * (d + 1) + j];
-        points_cf = (CH_FLOAT *)ch_realloc(points_cf, size_t(nFaces) * sizeof(CH_FLOAT));
-        visible_ind = (int *)ch_realloc(visible_ind, size_t(nFaces) * sizeof(int));
-#ifdef CONVHULL_3D_USE_CBLAS
-#ifdef CONVHULL_3D_USE_SINGLE_PRECISION
-        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, 1, nFaces, d, 1.0f, points_s, d, cf, d, 0.0f, points_cf,
-                    nFaces);
-#else
-        cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, 1, nFaces, d, 1.0, points_s, d, cf, d, 0.0, points_cf,
-                    nFaces);
+    (*out_faces) = NULL;
+    (*nOut_faces) = 0;
+    if (nVert < 4 || in_vertices == NULL)
+        return CH_OK;
+
+    /* 3 dimensions. The code should theoretically work for >=2 dimensions, but "plane_3d" and "det_4x4" are hardcoded for 3,
+     * so would need to be rewritten */
+    d = 3;
+    if (!ctx_reserve_points(ctx, nVert) || !ctx_reserve_faces(ctx, 64))
+        return CH_ERROR_MEMORY;
+
+    /* With a spatial insertion order, the points are copied in that order, and order[i] is the input index of point i.
+     * Otherwise, the points keep their input order */
+    order = NULL;
+    if (options->insertion_order == CH_ORDER_MORTON || options->insertion_order == CH_ORDER_BRIO)
+    {
+        order = ctx->order;
+        insertion_order(&in_vertices[0][0], d, nVert, d, options->insertion_order == CH_ORDER_BRIO, options->seed,
+                        options->num_threads, ctx->order_ws, order);
+    }
+
+    /* Add noise to the points. With exact predicates, there is no need for noise, so the input vertices are read in
+     * place (or, in single precision or in another order, just copied). The noise is keyed to the input index, so it
+     * does not depend on the order */
+    exact = options->exact_predicates;
+#ifndef CONVHULL_3D_USE_SINGLE_PRECISION
+    if (exact && order == NULL)
+    {
+        static_assert(sizeof(ch_vertex) == 3 * sizeof(CH_FLOAT), "ch_vertex must be 3 packed coordinates");
+        points = &in_vertices[0][0];
+        ps = d;
+    }
+    else
 #endif
-#else
-        for (j = 0; j < nFaces; j++)
+    {
+        points = ctx->points;
+        ps = d + 1;
+        for (i = 0; i < nVert; i++)
+        {
+            p = order == NULL ? i : order[i];
+            for (j = 0; j < d; j++)
+                points[i * ps + j] = in_vertices[p][size_t(j)] +
+                                     (jitter && !exact ? CH_NOISE_VAL * ch_noise(options->seed, uint64_t(p) * 3 + uint64_t(j))
+                                                       : 0.0); /* noise mitigates duplicates */
+            points[i * ps + d] = 1.0f; /* add a last column of ones. Used only for determinant calculation */
+        }
+    }
+
+    status = quickhull_3d(ctx, points, ps, nVert, options, order != NULL, &nFaces);
+    if (status != CH_OK && status != CH_CANCELLED)
+        return status;
+
+    /* Map the faces back to the input indices */
+    faces = ctx->faces;
+    if (order != NULL)
+        for (j = 0; j < nFaces * d; j++)
+            faces[j] = order[faces[j]];
+
+    /* output */
+    (*out_faces) = faces;
+    (*nOut_faces) = nFaces;
+    return status;
+}
+
+void convhull_3d_options_default(convhull_3d_options *options)
+{
+    memset(options, 0, sizeof(convhull_3d_options));
+    options->max_faces = 0;
+    options->kdop_directions = 14;
+    options->num_threads = 1;
+    options->num_chunks = 0;
+    options->seed = 0;
+    options->exact_predicates = 0;
+    options->insertion_order = CH_ORDER_DISTANCE;
+    options->lower_hull = 0;
+    options->time_budget = 0.0;
+    options->cancel = NULL;
+}
+
+ch_status convhull_3d_build_ctx(convhull_3d_context *ctx, ch_vertex *const in_vertices, const int nVert,
+                                const convhull_3d_options *options, int **out_faces, int *nOut_faces)
+{
+    convhull_3d_options default_options;
+    ch_status status;
+
+    if (options == NULL)
+    {
+        convhull_3d_options_default(&default_options);
+        options = &default_options;
+    }
+    ctx_start_clock(ctx, options);
+    status = convhull_3d_build_ws(ctx, in_vertices, nVert, options, 1, out_faces, nOut_faces);
+    if (status != CH_OK && status != CH_CANCELLED)
+    {
+        (*out_faces) = NULL;
+        (*nOut_faces) = 0;
+    }
+    return status;
+}
+
+int convhull_3d_unprocessed(const convhull_3d_context *ctx)
+{
+    return ctx->nUnprocessed;
+}
+
+ch_status convhull_3d_build_hint(convhull_3d_context *ctx, ch_vertex *const in_vertices, const int nVert,
+                                 const convhull_3d_options *options, const int *hint_faces, const int nHint_faces,
+                                 int **out_faces, int *nOut_faces)
+{
+    convhull_3d_options default_options;
+    ch_status status;
+    ch_owners walker;
+    int start[6 * CH_WALK_GRID * CH_WALK_GRID];
+    CH_FLOAT dist, radius;
+    CH_FLOAT *points, *pl;
+    int i, j, k, p, f, ld, exact, nSeed, nCand, nFaces, nPending;
+    int *mark, *order, *cand, *faces;
+
+    if (options == NULL)
+    {
+        convhull_3d_options_default(&default_options);
+        options = &default_options;
+    }
+    (*out_faces) = NULL;
+    (*nOut_faces) = 0;
+    if (nVert < 4 || in_vertices == NULL)
+        return CH_OK;
+    exact = options->exact_predicates;
+    ctx_start_clock(ctx, options);
+    if (!ctx_reserve_points(ctx, nVert))
+        return CH_ERROR_MEMORY;
+
+    /* The vertices of the hint (which are marked before ctx's faces are touched, as the hint may be those faces) */
+    mark = ctx->cand;
+    memset(mark, 0, size_t(nVert) * sizeof(int));
+    for (k = 0, nSeed = 0; k < nHint_faces * 3; k++)
+    {
+        p = hint_faces[k];
+        if (p >= 0 && p < nVert && !mark[p])
+        {
+            mark[p] = 1;
+            nSeed++;
+        }
+    }
+    if (nSeed < 4)
+        return convhull_3d_build_ctx(ctx, in_vertices, nVert, options, out_faces, nOut_faces);
+    if (!ctx_reserve_faces(ctx, 64))
+        return CH_ERROR_MEMORY;
+
+    /* The points are copied with the vertices of the hint first, and then the others. order[i] is the input index of
+     * point i, and the noise is keyed to it (as in convhull_3d_build_ws()) */
+    order = ctx->order;
+    for (i = 0, j = 0, k = nSeed; i < nVert; i++)
+    {
+        if (mark[i])
+            order[j++] = i;
+        else
+            order[k++] = i;
+    }
+    points = ctx->points;
+    for (i = 0; i < nVert; i++)
+    {
+        p = order[i];
+        for (j = 0; j < 3; j++)
+            points[i * 4 + j] =
+              in_vertices[p][size_t(j)] +
+              (exact ? 0.0 : CH_NOISE_VAL * ch_noise(options->seed, uint64_t(p) * 3 + uint64_t(j)));
+        points[i * 4 + 3] = 1.0f;
+    }
+
+    /* The hull of the vertices of the hint. If the build is stopped before it is done, the other points are all left
+     * unprocessed, and are not located */
+    status = quickhull_3d(ctx, points, 4, nSeed, options, 1, &nFaces);
+    if (status == CH_ERROR_DEGENERATE)
+        return convhull_3d_build_ctx(ctx, in_vertices, nVert, options, out_faces, nOut_faces);
+    if (status == CH_CANCELLED)
+        ctx->nUnprocessed += nVert - nSeed;
+    else if (status != CH_OK)
+        return status;
+
+    /* Locate each of the other points. Those inside the largest ball about the centroid of the vertices that fits in
+     * the hull are inside the hull, and are skipped straight away; as are those strictly inside the k-DOP (see
+     * quickhull_3d()), if the ball leaves more than a quarter of the points (e.g. for long, thin hulls). For the rest,
+     * the face that the ray from the centroid through the point leaves the hull by is found; the point is inside the
+     * hull if it is below this face, and otherwise it is above it, and so joins its outside set */
+    memset(&walker, 0, sizeof(ch_owners));
+    for (i = 0; i < nSeed; i++)
+        for (j = 0; j < 3; j++)
+            walker.centre[j] += points[i * 4 + j] / (CH_FLOAT)nSeed;
+    walker.walk = options->seed;
+    faces = ctx->faces;
+    pl = ctx->planes.data;
+    ld = ctx->planes.ld;
+    radius = CH_FLT_MAX;
+    for (f = 0; f < nFaces; f++)
+    {
+        ctx->fhead[f] = ctx->ffar[f] = -1;
+        ctx->ffar_dist[f] = 0.0;
+        dist = -pl[3 * ld + f];
+        for (k = 0; k < 3; k++)
+            dist -= walker.centre[k] * pl[k * ld + f];
+        radius = MIN(radius, dist);
+    }
+    radius = radius * (CH_FLOAT)0.999; /* (the planes are normalised, and the margin covers their rounding errors) */
+    radius = radius > 0.0 ? radius * radius : -1.0;
+    cand = ctx->cand;
+    for (i = status == CH_OK ? nSeed : nVert, nCand = 0; i < nVert; i++)
+    {
+        dist = 0.0;
+        for (k = 0; k < 3; k++)
+            dist += (points[i * 4 + k] - walker.centre[k]) * (points[i * 4 + k] - walker.centre[k]);
+        if (dist >= radius)
+            cand[nCand++] = i;
+    }
+    if (nCand > (nVert - nSeed) / 4 && options->kdop_directions > 0 && ctx->kdop_ws == NULL)
+        ctx->kdop_ws = (kdop_task *)ch_malloc(sizeof(kdop_task));
+    if (nCand > (nVert - nSeed) / 4 && options->kdop_directions > 0 && ctx->kdop_ws != NULL)
+    {
+        nCand = kdop_cull(ctx->kdop_ws, &ctx->kdop, points, 4, nVert, options->kdop_directions, options->num_threads,
+                          ctx->pnext, cand);
+    }
+    for (k = 0; k < 6 * CH_WALK_GRID * CH_WALK_GRID; k++)
+        start[k] = 0;
+    nPending = 0;
+    for (j = 0; j < nCand; j++)
+    {
+        i = cand[j];
+        dist = 0.0;
+        for (k = 0; k < 3; k++)
+            dist += (points[i * 4 + k] - walker.centre[k]) * (points[i * 4 + k] - walker.centre[k]);
+        if (i < nSeed || dist < radius)
+            continue;
+        k = direction_cell(walker.centre, &points[i * 4]);
+        f = start[k] = owner_walk(&walker, points, 4, faces, ctx->fnbr, nFaces, start[k], i);
+        dist = pl[3 * ld + f];
+        for (k = 0; k < 3; k++)
+            dist += points[i * 4 + k] * pl[k * ld + f];
+        if (exact ? face_orient(points, 4, &faces[f * 3], i, 1) >= 0 : dist <= 0.0)
+            continue;
+        if (ctx->fhead[f] == -1)
+            ctx->pending[nPending++] = f;
+        ctx->pnext[i] = ctx->fhead[f];
+        ctx->fhead[f] = i;
+        if (ctx->ffar[f] == -1 || dist > ctx->ffar_dist[f])
+        {
+            ctx->ffar_dist[f] = dist;
+            ctx->ffar[f] = i;
+        }
+    }
+
+    /* Add the points that are outside, and map the faces back to the input indices */
+    if (status == CH_OK)
+        status = quickhull_3d_expand(ctx, points, 4, options, &nFaces, nPending);
+    if (status != CH_OK && status != CH_CANCELLED)
+        return status;
+    faces = ctx->faces;
+    for (k = 0; k < nFaces * 3; k++)
+        faces[k] = order[faces[k]];
+    (*out_faces) = faces;
+    (*nOut_faces) = nFaces;
+    return status;
+}
+
+/* Makes sure that the buffers for parallel builds can hold at least 'nVert' points, and that there are 'nThreads'
+ * worker contexts. Returns 0 if the memory cannot be had */
+static int ctx_reserve_parallel(convhull_3d_context *ctx, const int nVert, const int nThreads)
+{
+    int i, ok;
+    size_t n;
+    if (nVert > ctx->maxParVert)
+    {
+        n = size_t(MAX(nVert, 2 * ctx->maxParVert));
+        ok = ch_grow(&ctx->par_points, n);
+        ok = ok && ch_grow(&ctx->par_union, n);
+        ok = ok && ch_grow(&ctx->par_ind, n);
+        ok = ok && ch_grow(&ctx->par_mark, n);
+        if (!ok)
+            return 0;
+        ctx->maxParVert = int(n);
+    }
+    for (i = 0; i < nThreads; i++)
+    {
+        if (ctx->workers[i] == NULL)
+            ctx->workers[i] = convhull_3d_context_create();
+        if (ctx->workers[i] == NULL)
+            return 0;
+    }
+    return 1;
+}
+
+/* Shared state of a parallel build; the chunks are handed out to the threads through 'next' */
+typedef struct parallel_task
+{
+    convhull_3d_context *ctx;
+    ch_vertex *in_vertices;
+    convhull_3d_options options; /* options for the hull of each chunk */
+    int nVert, nChunks;
+    std::atomic<int> next;
+} parallel_task;
+
+/* Builds the hulls of the chunks handed out to thread t, and marks their vertices in ctx->par_mark. The hull of a
+ * chunk that is stopped part way (see ch_stopped()) is passed on as it is, and the points that it left unprocessed
+ * are counted by the thread's context */
+static void parallel_chunks(void *arg, const int t)
+{
+    parallel_task *task = (parallel_task *)arg;
+    convhull_3d_context *ctx = task->ctx;
+    ch_status status;
+    int c, i, j, lo, hi, nFaces;
+    int *faces;
+
+    while ((c = task->next.fetch_add(1)) < task->nChunks)
+    {
+        lo = split_range(0, task->nVert, task->nChunks, c);
+        hi = split_range(0, task->nVert, task->nChunks, c + 1);
+        memset(&ctx->par_mark[lo], 0, size_t(hi - lo) * sizeof(int));
+
+        /* The noise of each point depends only on its index (not on the chunk), so the final hull sees the same
+         * points as the hulls of the chunks. There is no noise with exact predicates */
+        for (i = lo; i < hi; i++)
+            for (j = 0; j < 3; j++)
+                ctx->par_points[i][size_t(j)] =
+                  task->in_vertices[i][size_t(j)] +
+                  (task->options.exact_predicates ? 0.0
+                                                  : CH_NOISE_VAL * ch_noise(task->options.seed, uint64_t(i) * 3 + uint64_t(j)));
+        status = convhull_3d_build_ws(ctx->workers[t], &ctx->par_points[lo], hi - lo, &task->options, 0, &faces,
+                                      &nFaces);
+        if ((status == CH_OK || status == CH_CANCELLED) && faces != NULL)
+        {
+            for (i = 0; i < nFaces * 3; i++)
+                ctx->par_mark[lo + faces[i]] = 1;
+        }
+        else
+        {
+            /* Too few points, or they do not span 3 dimensions; so they are all passed on to the final hull */
+            for (i = lo; i < hi; i++)
+                ctx->par_mark[i] = 1;
+        }
+    }
+}
+
+ch_status convhull_3d_build_parallel(convhull_3d_context *ctx, ch_vertex *const in_vertices, const int nVert,
+                                     const convhull_3d_options *options, int **out_faces, int *nOut_faces)
+{
+    convhull_3d_options default_options;
+    parallel_task task;
+    ch_status status;
+    int i, nThreads, nUnion;
+
+    if (options == NULL)
+    {
+        convhull_3d_options_default(&default_options);
+        options = &default_options;
+    }
+    nThreads = MAX(1, MIN(options->num_threads, CH_MAX_THREADS));
+    task.nChunks = options->num_chunks > 0 ? options->num_chunks : nThreads;
+    task.nChunks = MIN(task.nChunks, nVert / 4);
+    nThreads = MIN(nThreads, task.nChunks);
+    if (task.nChunks <= 1 || in_vertices == NULL)
+        return convhull_3d_build_ctx(ctx, in_vertices, nVert, options, out_faces, nOut_faces);
+
+    /* Hulls of the chunks, which all share the time budget of the whole build */
+    if (!ctx_reserve_parallel(ctx, nVert, nThreads))
+    {
+        (*out_faces) = NULL;
+        (*nOut_faces) = 0;
+        return CH_ERROR_MEMORY;
+    }
+    ctx_start_clock(ctx, options);
+    for (i = 0; i < nThreads; i++)
+    {
+        ctx->workers[i]->deadline = ctx->deadline;
+        ctx->workers[i]->nUnprocessed = 0;
+    }
+    task.ctx = ctx;
+    task.in_vertices = in_vertices;
+    task.options = *options;
+    task.options.max_faces = 0;
+    task.options.num_threads = 1;
+    task.nVert = nVert;
+    task.next = 0;
+    parallel_run(nThreads, parallel_chunks, &task);
+    for (i = 0; i < nThreads; i++)
+        ctx->nUnprocessed += ctx->workers[i]->nUnprocessed;
+
+    /* Final hull, over the vertices of the hulls of the chunks */
+    for (i = 0, nUnion = 0; i < nVert; i++)
+    {
+        if (ctx->par_mark[i])
+        {
+            ctx->par_union[nUnion] = ctx->par_points[i];
+            ctx->par_ind[nUnion++] = i;
+        }
+    }
+    status = convhull_3d_build_ws(ctx, ctx->par_union, nUnion, options, 0, out_faces, nOut_faces);
+    if ((status != CH_OK && status != CH_CANCELLED) || (*out_faces) == NULL)
+    {
+        (*out_faces) = NULL;
+        (*nOut_faces) = 0;
+        return status;
+    }
+    for (i = 0; i < (*nOut_faces) * 3; i++)
+        (*out_faces)[i] = ctx->par_ind[(*out_faces)[i]];
+    return ctx->nUnprocessed > 0 ? CH_CANCELLED : status;
+}
+
+/* Queue of the items of a batch build that have been dealt to one thread. The owner takes items from the front, and
+ * other threads steal them from the back */
+typedef struct batch_queue
+{
+    std::mutex lock;
+    int head, tail; /* range of ctx->batch_order that is still queued */
+} batch_queue;
+
+typedef struct batch_task
+{
+    convhull_3d_context *ctx;
+    convhull_3d_batch_item *items;
+    convhull_3d_options options; /* options for each item */
+    int nThreads;
+    batch_queue queues[CH_MAX_THREADS];
+} batch_task;
+
+/* Takes the next item for thread t: from the front of its own queue, or else from the back of another's. Returns -1
+ * once all of the queues are empty */
+static int batch_next(batch_task *task, const int t)
+{
+    batch_queue *q;
+    int i, v, item;
+
+    q = &task->queues[t];
+    q->lock.lock();
+    item = q->head < q->tail ? task->ctx->batch_order[q->head++] : -1;
+    q->lock.unlock();
+    for (i = 1; i < task->nThreads && item == -1; i++)
+    {
+        v = (t + i) % task->nThreads;
+        q = &task->queues[v];
+        q->lock.lock();
+        item = q->head < q->tail ? task->ctx->batch_order[--q->tail] : -1;
+        q->lock.unlock();
+    }
+    return item;
+}
+
+static void batch_worker(void *arg, const int t)
+{
+    batch_task *task = (batch_task *)arg;
+    convhull_3d_batch_item *item;
+    int i, *faces;
+
+    while ((i = batch_next(task, t)) != -1)
+    {
+        item = &task->items[i];
+        task->ctx->workers[t]->nUnprocessed = 0;
+        item->status = convhull_3d_build_ws(task->ctx->workers[t], item->vertices, item->nVert, &task->options, 1, &faces,
+                                            &item->nFaces);
+        item->nUnprocessed = task->ctx->workers[t]->nUnprocessed;
+        item->faces = NULL;
+        if ((item->status == CH_OK || item->status == CH_CANCELLED) && faces != NULL)
+        {
+            item->faces = (int *)ch_malloc(size_t(item->nFaces * 3) * sizeof(int));
+            if (item->faces != NULL)
+                memcpy(item->faces, faces, size_t(item->nFaces * 3) * sizeof(int));
+            else
+                item->status = CH_ERROR_MEMORY;
+        }
+        if (item->faces == NULL)
+        {
+            item->faces = NULL;
+            item->nFaces = 0;
+        }
+    }
+}
+
+void convhull_3d_build_batch(convhull_3d_context *ctx, convhull_3d_batch_item *items, const int nItems,
+                             const convhull_3d_options *options)
+{
+    convhull_3d_options default_options;
+    batch_task *task;
+    int i, t, n, ok, nThreads;
+
+    if (nItems <= 0)
+        return;
+    if (options == NULL)
+    {
+        convhull_3d_options_default(&default_options);
+        options = &default_options;
+    }
+    task = new (std::nothrow) batch_task;
+    nThreads = MAX(1, MIN(MIN(options->num_threads, CH_MAX_THREADS), nItems));
+    ok = task != NULL && ctx_reserve_parallel(ctx, nItems, nThreads);
+    if (ok && nItems > ctx->maxBatch)
+    {
+        n = MAX(nItems, 2 * ctx->maxBatch);
+        ok = ch_grow(&ctx->batch_order, size_t(n));
+        if (ok)
+            ctx->maxBatch = n;
+    }
+    if (!ok)
+    {
+        for (i = 0; i < nItems; i++)
+        {
+            items[i].faces = NULL;
+            items[i].nFaces = items[i].nUnprocessed = 0;
+            items[i].status = CH_ERROR_MEMORY;
+        }
+        delete task;
+        return;
+    }
+    task->nThreads = nThreads;
+
+    /* Deal the items out from largest to smallest, so that each queue gets a similar share of the work, and the small
+     * items that are left over at the back are the ones that get stolen */
+    for (i = 0; i < nItems; i++)
+    {
+        ctx->par_mark[i] = items[i].vertices == NULL ? 0 : items[i].nVert;
+        ctx->batch_order[i] = i;
+    }
+    sort_int(ctx->par_mark, NULL, ctx->batch_order, nItems, 1); /* (left in order, if there is not the memory) */
+    for (i = 0; i < nItems; i++)
+        ctx->par_mark[i] = ctx->batch_order[i];
+    for (t = 0, n = 0; t < task->nThreads; t++)
+    {
+        task->queues[t].head = n;
+        for (i = t; i < nItems; i += task->nThreads)
+            ctx->batch_order[n++] = ctx->par_mark[i];
+        task->queues[t].tail = n;
+    }
+
+    /* The items all share the time budget of the whole batch; those that are not done by then are cut short */
+    ctx_start_clock(ctx, options);
+    for (t = 0; t < task->nThreads; t++)
+        ctx->workers[t]->deadline = ctx->deadline;
+
+    task->ctx = ctx;
+    task->items = items;
+    task->options = *options;
+    task->options.num_threads = 1;
+    parallel_run(task->nThreads, batch_worker, task);
+    delete task;
+}
+
+struct _convhull_3d_hull
+{
+    convhull_3d_options options;
+    convhull_3d_context *ctx; /* the faces, and the (noisy) copies of all of the points added so far */
+    convhull_3d_context *work; /* for building the hulls of the holes left by removed vertices; created on first use */
+    ch_owners owners; /* the interior points, and the vertices; see ch_owners */
+    int nPoints; /* number of points added so far */
+    int nAlive; /* number of points that have not been removed */
+    int nFaces; /* number of faces; 0 if the hull has not been built */
+    int tracked; /* 1 once points have been removed or moved; from then on, the interior points are kept track of */
+    int maxPoints;
+    unsigned char *removed; /* 1 for the points that have been removed (or are being moved) */
+    int *lmark; /* boundary edge of a hole that starts at each point, or -1 */
+    int maxOut;
+    int *out; /* the faces, gathered by convhull_3d_hull_faces(); flat: nFaces x 3 */
+};
+
+/* Makes sure that the per-point buffers of the hull can hold at least 'nPoints' points. Returns 0 if the memory cannot
+ * be had (see ctx_reserve_points()) */
+static int hull_reserve_points(convhull_3d_hull *hull, const int nPoints)
+{
+    ch_owners *ow;
+    int ok;
+    size_t n;
+
+    if (!ctx_reserve_points(hull->ctx, nPoints))
+        return 0;
+    if (nPoints <= hull->maxPoints)
+        return 1;
+    ow = &hull->owners;
+    n = size_t(MAX(nPoints, 2 * hull->maxPoints));
+    ok = ch_grow(&ow->inext, n);
+    ok = ok && ch_grow(&ow->iprev, n);
+    ok = ok && ch_grow(&ow->iown, n);
+    ok = ok && ch_grow(&ow->vface, n);
+    ok = ok && ch_grow(&hull->removed, n);
+    ok = ok && ch_grow(&hull->lmark, n);
+    if (!ok)
+        return 0;
+    memset(hull->lmark + hull->maxPoints, -1, (n - size_t(hull->maxPoints)) * sizeof(int));
+    hull->maxPoints = int(n);
+    return 1;
+}
+
+/* Copies point p of the hull (with the same noise as convhull_3d_build_ws() would add) */
+static void hull_set_point(convhull_3d_hull *hull, const int p, const ch_vertex *point)
+{
+    int j;
+    for (j = 0; j < 3; j++)
+        hull->ctx->points[p * 4 + j] =
+          (*point)[size_t(j)] + (hull->options.exact_predicates
+                                   ? 0.0
+                                   : CH_NOISE_VAL * ch_noise(hull->options.seed, uint64_t(p) * 3 + uint64_t(j)));
+    hull->ctx->points[p * 4 + 3] = 1.0f;
+    hull->removed[p] = 0;
+    hull->owners.iown[p] = hull->owners.vface[p] = -1;
+}
+
+/* Gives every point that is inside the hull to the face that owns it, about a new centre (the centroid of the
+ * points, which is strictly inside the hull). The points are taken along a Morton curve, so that each walk starts off
+ * near the face that it is looking for */
+static void hull_own_all(convhull_3d_hull *hull)
+{
+    convhull_3d_context *ctx;
+    ch_owners *ow;
+    int i, j, p, f;
+
+    ctx = hull->ctx;
+    ow = &hull->owners;
+    for (j = 0; j < 3; j++)
+        ow->centre[j] = 0.0;
+    for (p = 0; p < hull->nPoints; p++)
+    {
+        ow->iown[p] = -1;
+        if (!hull->removed[p])
+            for (j = 0; j < 3; j++)
+                ow->centre[j] += ctx->points[p * 4 + j];
+    }
+    for (j = 0; j < 3; j++)
+        ow->centre[j] /= (CH_FLOAT)hull->nAlive;
+    for (f = 0; f < ow->nSlots; f++)
+        ow->fin[f] = -1;
+
+    insertion_order(ctx->points, 4, hull->nPoints, 3, 0, hull->options.seed, 1, ctx->order_ws, ctx->order);
+    for (f = 0; ctx->faces[f * 3] == -1; f++)
+        ;
+    for (i = 0; i < hull->nPoints; i++)
+    {
+        p = ctx->order[i];
+        if (hull->removed[p] || ow->vface[p] != -1)
+            continue;
+        f = owner_walk(ow, ctx->points, 4, ctx->faces, ctx->fnbr, ow->nSlots, f, p);
+        own_point(ow, p, f);
+    }
+}
+
+/* Starts keeping track of the interior points of the hull, which has just been built (and whose faces are therefore
+ * compacted). From now on, the faces are kept in place, and the interior points are owned by the faces. Returns 0 if
+ * the memory cannot be had */
+static int hull_track(convhull_3d_hull *hull)
+{
+    convhull_3d_context *ctx;
+    ch_owners *ow;
+    int p, k;
+
+    ctx = hull->ctx;
+    ow = &hull->owners;
+    if (!ch_grow(&ow->fin, size_t(ctx->maxFaces)))
+        return 0;
+    ow->nSlots = hull->nFaces;
+    ow->nFree = 0;
+    ctx->owners = ow;
+    for (p = 0; p < hull->nPoints; p++)
+        ow->vface[p] = -1;
+    for (k = 0; k < hull->nFaces * 3; k++)
+        ow->vface[ctx->faces[k]] = k / 3;
+    hull_own_all(hull);
+    return 1;
+}
+
+/* Builds the hull from scratch, from all of the points that have not been removed */
+static ch_status hull_rebuild(convhull_3d_hull *hull)
+{
+    convhull_3d_context *ctx, *work;
+    ch_status status;
+    CH_FLOAT *points;
+    int j, k, p, n, nFaces;
+
+    ctx = hull->ctx;
+    ctx->owners = NULL;
+    hull->nFaces = 0;
+    if (hull->nAlive < 4)
+        return CH_OK;
+
+    /* If points have been removed, then the others are gathered into the work context first; work->order[i] is the
+     * index of the i'th of them */
+    work = NULL;
+    points = ctx->points;
+    if (hull->nAlive < hull->nPoints)
+    {
+        if (hull->work == NULL)
+            hull->work = convhull_3d_context_create();
+        work = hull->work;
+        if (work == NULL || !ctx_reserve_points(work, hull->nAlive))
+            return CH_ERROR_MEMORY;
+        for (p = 0, n = 0; p < hull->nPoints; p++)
+        {
+            if (hull->removed[p])
+                continue;
+            for (j = 0; j < 4; j++)
+                work->points[n * 4 + j] = ctx->points[p * 4 + j];
+            work->order[n++] = p;
+        }
+        points = work->points;
+    }
+    if (!ctx_reserve_faces(ctx, 64))
+        return CH_ERROR_MEMORY;
+    status = quickhull_3d(ctx, points, 4, hull->nAlive, &hull->options, 0, &nFaces);
+    if (status != CH_OK)
+        return status;
+    if (work != NULL)
+        for (k = 0; k < nFaces * 3; k++)
+            ctx->faces[k] = work->order[ctx->faces[k]];
+    hull->nFaces = nFaces;
+    if (hull->tracked && !hull_track(hull))
+    {
+        hull->nFaces = 0;
+        return CH_ERROR_MEMORY;
+    }
+    return CH_OK;
+}
+
+/* Adds the points pts[0..n), which are not in the hull yet, to the hull */
+static ch_status hull_add(convhull_3d_hull *hull, const int *pts, const int n)
+{
+    convhull_3d_context *ctx;
+    ch_status status;
+
+    ctx = hull->ctx;
+    if (hull->nFaces == 0)
+        return hull_rebuild(hull);
+    status = quickhull_3d_expand(ctx, ctx->points, 4, &hull->options, &hull->nFaces,
+                                 quickhull_3d_assign(ctx, ctx->points, 4, hull->options.exact_predicates, pts, n,
+                                                     hull->tracked ? hull->owners.nSlots : hull->nFaces, 0));
+    if (status != CH_OK)
+    {
+        hull->nFaces = 0;
+        ctx->owners = NULL;
+    }
+    return status;
+}
+
+/* Removes vertex v from the hull, by deleting the faces around it, and filling the hole with the faces of the hull
+ * of the points that could now be vertices: those on the boundary of the hole, and those that the deleted faces
+ * owned. Of these faces, the ones that fill the hole are those that v is above; which is checked, by making sure that
+ * their boundary is that of the hole. The points that the deleted faces owned are only all of the points that could
+ * now be vertices if the centre (see ch_owners) is strictly inside the new faces; if it is not, then all of the points
+ * are first given new owners about a new centre (unless 'recentred', i.e. that has already been done), and the hole is
+ * found again. Returns 0 if the hole could not be filled (e.g. if these points are coplanar), in which case the hull is
+ * left as it was */
+static int hull_remove_vertex(convhull_3d_hull *hull, const int v, const int recentred)
+{
+    const int d = 3;
+    convhull_3d_context *ctx, *work;
+    convhull_3d_options options;
+    ch_owners *ow;
+    CH_FLOAT cfi[3], p_s[9], dfi;
+    CH_FLOAT *points, *pl;
+    int i, j, k, l, e, f, g, m, p, ok, nStar, nCand, nHole, nBoundary, nWork, ld, hint, centred;
+    int *faces, *fnbr, *star, *mark, *horizon, *hz_face, *hz_slot, *cand, *lmark, *wfaces, *wfnbr, *slot;
+
+    ctx = hull->ctx;
+    ow = &hull->owners;
+    points = ctx->points;
+    faces = ctx->faces;
+    fnbr = ctx->fnbr;
+    lmark = hull->lmark;
+
+    /* The faces around v (its star), found by walking from ow->vface[v]; marked with 1 in visible_ind */
+    star = ctx->visible;
+    mark = ctx->visible_ind;
+    nStar = 0;
+    star[nStar++] = ow->vface[v];
+    mark[ow->vface[v]] = 1;
+    for (j = 0; j < nStar; j++)
+    {
+        for (k = 0; k < d; k++)
+        {
+            g = fnbr[star[j] * d + k];
+            if (mark[g] == 0 && (faces[g * d] == v || faces[g * d + 1] == v || faces[g * d + 2] == v))
+            {
+                mark[g] = 1;
+                star[nStar++] = g;
+            }
+        }
+    }
+
+    /* The boundary of the hole: the edge of each face of the star that is opposite v, taken in the direction that it
+     * runs around that face (as for the horizon in quickhull_3d_expand()); lmark[a] is the edge that starts at a. The
+     * candidate points are the ends of these edges, followed by the points owned by the star */
+    horizon = ctx->horizon;
+    hz_face = ctx->hz_face;
+    hz_slot = ctx->hz_slot;
+    cand = ctx->ind;
+    ok = 1;
+    for (e = 0; e < nStar; e++)
+    {
+        f = star[e];
+        for (m = 0; faces[f * d + m] != v; m++)
+            ;
+        horizon[e * 2] = faces[f * d + (m + 1) % d];
+        horizon[e * 2 + 1] = faces[f * d + (m + 2) % d];
+        g = fnbr[f * d + m];
+        hz_face[e] = g;
+        for (l = 0; l < d; l++)
+            if (fnbr[g * d + l] == f)
+                hz_slot[e] = l;
+        ok = ok && mark[g] == 0 && lmark[horizon[e * 2]] == -1;
+        lmark[horizon[e * 2]] = e;
+        cand[e] = horizon[e * 2];
+    }
+    nCand = nStar;
+    for (j = 0; j < nStar; j++)
+        for (p = ow->fin[star[j]]; p != -1; p = ow->inext[p])
+            cand[nCand++] = p;
+
+    /* The hull of the candidates, in the work context */
+    nWork = 0;
+    if (ok)
+    {
+        if (hull->work == NULL)
+            hull->work = convhull_3d_context_create();
+        work = hull->work;
+        ok = work != NULL && ctx_reserve_points(work, nCand) && ctx_reserve_faces(work, 64);
+    }
+    if (ok)
+    {
+        for (i = 0; i < nCand; i++)
+            for (j = 0; j < 4; j++)
+                work->points[i * 4 + j] = points[cand[i] * 4 + j];
+        options = hull->options;
+        options.max_faces = 0;
+        options.num_threads = 1;
+        ok = nCand >= 4 && quickhull_3d(work, work->points, 4, nCand, &options, 0, &nWork) == CH_OK;
+    }
+
+    /* Its faces that v is above fill the hole; slot[f] is set to 0 for them, and -1 for the others. Their boundary
+     * edges must each match an edge of the hole's boundary, whose lmark is then set to (-2-e) */
+    nHole = nBoundary = 0;
+    centred = 1;
+    wfaces = wfnbr = slot = NULL;
+    if (ok)
+    {
+        wfaces = work->faces;
+        wfnbr = work->fnbr;
+        slot = work->fremap;
+        for (f = 0; f < nWork; f++)
         {
-            points_cf[j] = 0;
-            for (k = 0; k < d; k++)
-                points_cf[j] += points_s[k] * cf[j * d + k];
+            slot[f] = orient3d(&points[cand[wfaces[f * d]] * 4], &points[cand[wfaces[f * d + 1]] * 4],
+                               &points[cand[wfaces[f * d + 2]] * 4], &points[v * 4]) < 0 ? 0 : -1;
+            nHole += slot[f] == 0;
+            centred = centred && (slot[f] == -1 || orient3d(&points[cand[wfaces[f * d]] * 4],
+                                                            &points[cand[wfaces[f * d + 1]] * 4],
+                                                            &points[cand[wfaces[f * d + 2]] * 4], ow->centre) > 0);
         }
-#endif
-        num_visible_ind = 0;
-        for (j = 0; j < nFaces; j++)
+        for (f = 0; f < nWork && ok; f++)
         {
-            if (points_cf[j] + df[j] > 0.0)
+            for (k = 0; k < d && ok && slot[f] == 0; k++)
             {
-                num_visible_ind++; /* will sum to 0 if none are visible */
-                visible_ind[j] = 1;
+                if (slot[wfnbr[f * d + k]] == 0)
+                    continue;
+                e = lmark[cand[wfaces[f * d + (k + 1) % d]]];
+                ok = e >= 0 && horizon[e * 2 + 1] == cand[wfaces[f * d + (k + 2) % d]];
+                if (ok)
+                    lmark[horizon[e * 2]] = -2 - e;
+                nBoundary++;
             }
-            else
-                visible_ind[j] = 0;
         }
-        num_nonvisible_faces = nFaces - num_visible_ind;
-
-        /* proceed if there are any visible faces */
-        if (num_visible_ind != 0)
+        ok = ok && nBoundary == nStar;
+    }
+    ok = ok && (hull->options.max_faces <= 0 || hull->nFaces - nStar + nHole <= hull->options.max_faces);
+    ok = ok && (centred || !recentred);
+
+    /* Make room for the faces that fill the hole (in the slots of the star first), before anything is deleted; so
+     * that the hull is left as it was if the memory cannot be had */
+    ok = ok && ctx_reserve_faces(ctx, ow->nSlots + MAX(nHole - ow->nFree - nStar, 0));
+    faces = ctx->faces;
+    fnbr = ctx->fnbr;
+    star = ctx->visible;
+    mark = ctx->visible_ind;
+    horizon = ctx->horizon;
+    hz_face = ctx->hz_face;
+    hz_slot = ctx->hz_slot;
+    if (!ok || !centred)
+    {
+        for (e = 0; e < nStar; e++)
         {
-            /* Find visible face indices */
-            visible = (int *)ch_malloc(size_t(num_visible_ind) * sizeof(int));
-            for (j = 0, k = 0; j < nFaces; j++)
-            {
-                if (visible_ind[j] == 1)
-                {
-                    visible[k] = j;
-                    k++;
-                }
-            }
+            lmark[horizon[e * 2]] = -1;
+            mark[star[e]] = 0;
+        }
+        if (!ok)
+            return 0;
+        hull_own_all(hull);
+        return hull_remove_vertex(hull, v, 1);
+    }
 
-            /* Find nonvisible faces */
-            nonvisible_faces = (int *)ch_malloc(size_t(num_nonvisible_faces) * size_t(d) * sizeof(int));
-            f0 = (int *)ch_malloc(size_t(num_nonvisible_faces * d) * sizeof(int));
-            for (j = 0, k = 0; j < nFaces; j++)
-            {
-                if (visible_ind[j] == 0)
-                {
-                    for (l = 0; l < d; l++)
-                        nonvisible_faces[k * d + l] = faces[j * d + l];
-                    k++;
-                }
-            }
+    /* Delete the star; its slots go on the free list */
+    pl = ctx->planes.data;
+    ld = ctx->planes.ld;
+    for (j = 0; j < nStar; j++)
+    {
+        f = star[j];
+        mark[f] = 0;
+        faces[f * d] = -1;
+        for (k = 0; k < d; k++)
+            pl[k * ld + f] = 0.0;
+        pl[d * ld + f] = -1.0;
+        ow->fin[f] = -1;
+        ctx->ffree[ow->nFree++] = f;
+    }
+    hull->nFaces -= nStar;
+    ow->vface[v] = -1;
 
-            /* Create horizon (count is the number of the edges of the horizon) */
-            count = 0;
-            for (j = 0; j < num_visible_ind; j++)
-            {
-                /* visible face */
-                vis = visible[j];
-                for (k = 0; k < d; k++)
-                    face_s[k] = faces[vis * d + k];
-                sort_int(face_s, NULL, NULL, d, 0);
-                ismember(nonvisible_faces, face_s, f0, num_nonvisible_faces * d, d);
-                u_len = 0;
+    /* Add the faces that fill the hole, in the free slots first */
+    for (f = 0; f < nWork; f++)
+    {
+        if (slot[f] == -1)
+            continue;
+        g = ow->nFree > 0 ? ctx->ffree[--ow->nFree] : ow->nSlots++;
+        slot[f] = g;
+        for (k = 0; k < d; k++)
+        {
+            faces[g * d + k] = cand[wfaces[f * d + k]];
+            ow->vface[faces[g * d + k]] = g;
+            for (l = 0; l < d; l++)
+                p_s[k * d + l] = points[faces[g * d + k] * 4 + l];
+        }
+        plane_3d(p_s, cfi, &dfi);
+        for (k = 0; k < d; k++)
+            pl[k * ld + g] = cfi[k];
+        pl[d * ld + g] = dfi;
+        ctx->fhead[g] = ctx->ffar[g] = -1;
+        ctx->ffar_dist[g] = 0.0;
+        ow->fin[g] = -1;
+    }
+    hull->nFaces += nHole;
 
-                /* u are the nonvisible faces connected to the face v, if any */
-                for (k = 0; k < num_nonvisible_faces; k++)
-                {
-                    f0_sum = 0;
-                    for (l = 0; l < d; l++)
-                        f0_sum += f0[k * d + l];
-                    if (f0_sum == d - 1)
-                    {
-                        u_len++;
-                        if (u_len == 1)
-                            u = (int *)ch_malloc(size_t(u_len) * sizeof(int));
-                        else
-                            u = (int *)ch_realloc(u, size_t(u_len) * sizeof(int));
-                        u[u_len - 1] = k;
-                    }
-                }
-                for (k = 0; k < u_len; k++)
-                {
-                    /* The boundary between the visible face v and the k(th) nonvisible face connected to the face v forms part of the horizon */
-                    count++;
-                    if (count == 1)
-                        horizon = (int *)ch_malloc(size_t(count * (d - 1)) * sizeof(int));
-                    else
-                        horizon = (int *)ch_realloc(horizon, size_t(count * (d - 1)) * sizeof(int));
-                    for (l = 0; l < d; l++)
-                        gVec[l] = nonvisible_faces[u[k] * d + l];
-                    for (l = 0, h = 0; l < d; l++)
-                    {
-                        if (f0[u[k] * d + l])
-                        {
-                            horizon[(count - 1) * (d - 1) + h] = gVec[l];
-                            h++;
-                        }
-                    }
-                }
-                if (u_len != 0)
-                    ch_free(u);
-            }
-            horizon_size1 = count;
-            for (j = 0, l = 0; j < nFaces; j++)
+    /* Link them to each other, and over the boundary of the hole */
+    for (f = 0; f < nWork; f++)
+    {
+        if (slot[f] == -1)
+            continue;
+        g = slot[f];
+        for (k = 0; k < d; k++)
+        {
+            if (slot[wfnbr[f * d + k]] != -1)
+                fnbr[g * d + k] = slot[wfnbr[f * d + k]];
+            else
             {
-                if (!visible_ind[j])
-                {
-                    /* Delete visible faces */
-                    for (k = 0; k < d; k++)
-                        faces[l * d + k] = faces[j * d + k];
-
-                    /* Delete the corresponding plane coefficients of the faces */
-                    for (k = 0; k < d; k++)
-                        cf[l * d + k] = cf[j * d + k];
-                    df[l] = df[j];
-                    l++;
-                }
+                e = -2 - lmark[faces[g * d + (k + 1) % d]];
+                fnbr[g * d + k] = hz_face[e];
+                fnbr[hz_face[e] * d + hz_slot[e]] = g;
             }
+        }
+    }
+    for (e = 0; e < nStar; e++)
+        lmark[horizon[e * 2]] = -1;
 
-            /* Update the number of faces */
-            nFaces = nFaces - num_visible_ind;
-            faces = (int *)ch_realloc(faces, size_t(nFaces * d) * sizeof(int));
-            cf = (CH_FLOAT *)ch_realloc(cf, size_t(nFaces * d) * sizeof(CH_FLOAT));
-            df = (CH_FLOAT *)ch_realloc(df, size_t(nFaces) * sizeof(CH_FLOAT));
+    /* The candidates that are still inside the hull are owned by the new faces */
+    for (f = 0, hint = -1; f < nWork && hint == -1; f++)
+        hint = slot[f];
+    for (i = nStar; i < nCand; i++)
+    {
+        p = cand[i];
+        ow->iown[p] = -1;
+        if (ow->vface[p] != -1)
+            continue;
+        hint = owner_walk(ow, points, 4, faces, fnbr, ow->nSlots, hint, p);
+        own_point(ow, p, hint);
+    }
+    return 1;
+}
 
-            /* start is the first row of the new faces */
-            start = nFaces;
+/* Takes point p out of the hull, and marks it as removed */
+static void hull_take_out(convhull_3d_hull *hull, const int p)
+{
+    hull->removed[p] = 1;
+    hull->nAlive--;
+    if (hull->nFaces == 0)
+        return;
+    if (hull->owners.vface[p] == -1)
+        disown_point(&hull->owners, p);
+    else if (!hull_remove_vertex(hull, p, 0))
+    {
+        hull->nFaces = 0; /* rebuilt by the caller */
+        hull->ctx->owners = NULL;
+    }
+}
 
-            /* Add faces connecting horizon to the new point */
-            n_newfaces = horizon_size1;
-            for (j = 0; j < n_newfaces; j++)
-            {
-                nFaces++;
-                faces = (int *)ch_realloc(faces, size_t(nFaces * d) * sizeof(int));
-                cf = (CH_FLOAT *)ch_realloc(cf, size_t(nFaces * d) * sizeof(CH_FLOAT));
-                df = (CH_FLOAT *)ch_realloc(df, size_t(nFaces) * sizeof(CH_FLOAT));
-                for (k = 0; k < d - 1; k++)
-                    faces[(nFaces - 1) * d + k] = horizon[j * (d - 1) + k];
-                faces[(nFaces - 1) * d + (d - 1)] = i;
+convhull_3d_hull *convhull_3d_hull_create(const convhull_3d_options *options)
+{
+    convhull_3d_hull *hull;
+    hull = (convhull_3d_hull *)ch_calloc(1, sizeof(convhull_3d_hull));
+    if (hull == NULL)
+        return NULL;
+    if (options != NULL)
+        hull->options = *options;
+    else
+        convhull_3d_options_default(&hull->options);
+    hull->options.insertion_order = CH_ORDER_DISTANCE;
+    hull->options.time_budget = 0.0;
+    hull->options.cancel = NULL;
+    hull->ctx = convhull_3d_context_create();
+    hull->owners.walk = hull->options.seed;
+    if (hull->ctx == NULL)
+    {
+        ch_free(hull);
+        return NULL;
+    }
+    return hull;
+}
 
-                /* Calculate and store appropriately the plane coefficients of the faces */
-                for (k = 0; k < d; k++)
-                    for (l = 0; l < d; l++)
-                        p_s[k * d + l] = points[(faces[(nFaces - 1) * d + k]) * (d + 1) + l];
-                plane_3d(p_s, cfi, &dfi);
-                for (k = 0; k < d; k++)
-                    cf[(nFaces - 1) * d + k] = cfi[k];
-                df[(nFaces - 1)] = dfi;
-                if (nFaces > CH_MAX_NUM_FACES)
-                {
-                    ERROR = 1;
-                    nFaces = 0;
-                    break;
-                }
-            }
+void convhull_3d_hull_destroy(convhull_3d_hull *hull)
+{
+    if (hull == NULL)
+        return;
+    convhull_3d_context_destroy(hull->ctx);
+    convhull_3d_context_destroy(hull->work);
+    ch_free(hull->owners.fin);
+    ch_free(hull->owners.inext);
+    ch_free(hull->owners.iprev);
+    ch_free(hull->owners.iown);
+    ch_free(hull->owners.vface);
+    ch_free(hull->removed);
+    ch_free(hull->lmark);
+    ch_free(hull->out);
+    ch_free(hull);
+}
 
-            /* Orient each new face properly */
-            hVec = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-            hVec_mem_face = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-            for (j = 0; j < nFaces; j++)
-                hVec[j] = j;
-            for (k = start; k < nFaces; k++)
-            {
-                for (j = 0; j < d; j++)
-                    face_s[j] = faces[k * d + j];
-                sort_int(face_s, NULL, NULL, d, 0);
-                ismember(hVec, face_s, hVec_mem_face, nFaces, d);
-                num_p = 0;
-                for (j = 0; j < nFaces; j++)
-                    if (!hVec_mem_face[j])
-                        num_p++;
-                pp = (int *)ch_malloc(size_t(num_p) * sizeof(int));
-                for (j = 0, l = 0; j < nFaces; j++)
-                {
-                    if (!hVec_mem_face[j])
-                    {
-                        pp[l] = hVec[j];
-                        l++;
-                    }
-                }
-                index = 0;
-                detA = 0.0;
+ch_status convhull_3d_insert(convhull_3d_hull *hull, ch_vertex *const points, const int n)
+{
+    int i, n0;
+
+    if (n <= 0 || points == NULL)
+        return CH_OK;
+
+    /* Copy the new points after the others */
+    n0 = hull->nPoints;
+    if (!hull_reserve_points(hull, n0 + n))
+        return CH_ERROR_MEMORY;
+    for (i = 0; i < n; i++)
+        hull_set_point(hull, n0 + i, &points[i]);
+    hull->nPoints += n;
+    hull->nAlive += n;
+
+    /* Grow the hull from its current faces (or build it, if it has not been built yet) */
+    for (i = 0; i < n; i++)
+        hull->ctx->cand[i] = n0 + i;
+    return hull_add(hull, hull->ctx->cand, n);
+}
 
-                /* While new point is coplanar, choose another point */
-                while (detA == 0.0)
-                {
-                    for (j = 0; j < d; j++)
-                        for (l = 0; l < d + 1; l++)
-                            A[j * (d + 1) + l] = points[(faces[k * d + j]) * (d + 1) + l];
-                    for (; j < d + 1; j++)
-                        for (l = 0; l < d + 1; l++)
-                            A[j * (d + 1) + l] = points[pp[index] * (d + 1) + l];
-                    index++;
-                    detA = det_4x4(A);
-                }
+/* Starts keeping track of the interior points, before the first removal */
+static void hull_start_tracking(convhull_3d_hull *hull)
+{
+    if (hull->tracked)
+        return;
+    hull->tracked = 1;
+    if (hull->nFaces > 0 && !hull_track(hull))
+        hull->nFaces = 0; /* rebuilt by the caller */
+}
 
-                /* Orient faces so that each point on the original simplex can't see the opposite face */
-                if (detA < 0.0)
-                {
-                    /* If orientation is improper, reverse the order to change the volume sign */
-                    for (j = 0; j < 2; j++)
-                        face_tmp[j] = faces[k * d + d - j - 1];
-                    for (j = 0; j < 2; j++)
-                        faces[k * d + d - j - 1] = face_tmp[1 - j];
+ch_status convhull_3d_remove(convhull_3d_hull *hull, const int *indices, const int n)
+{
+    int i;
 
-                    /* Modify the plane coefficients of the properly oriented faces */
-                    for (j = 0; j < d; j++)
-                        cf[k * d + j] = -cf[k * d + j];
-                    df[k] = -df[k];
-                    for (l = 0; l < d; l++)
-                        for (j = 0; j < d + 1; j++)
-                            A[l * (d + 1) + j] = points[(faces[k * d + l]) * (d + 1) + j];
-                    for (; l < d + 1; l++)
-                        for (j = 0; j < d + 1; j++)
-                            A[l * (d + 1) + j] = points[pp[index] * (d + 1) + j];
-#ifndef NDEBUG
-                    /* Check */
-                    detA = det_4x4(A);
-                    /* If you hit this assertion error, then the face cannot be properly orientated */
-                    if (detA <= 0.0)
-                    {
-                        throw std::runtime_error("face cannot be properly orientated");
-                    }
-#endif
-                }
-                ch_free(pp);
-            }
-            if (horizon_size1 > 0)
-                ch_free(horizon);
-            ch_free(f0);
-            ch_free(nonvisible_faces);
-            ch_free(visible);
-            ch_free(hVec);
-            ch_free(hVec_mem_face);
-        }
-        if (ERROR)
-        {
-            break;
-        }
+    hull_start_tracking(hull);
+    for (i = 0; i < n; i++)
+        if (indices[i] >= 0 && indices[i] < hull->nPoints && !hull->removed[indices[i]])
+            hull_take_out(hull, indices[i]);
+    if (hull->nFaces == 0)
+        return hull_rebuild(hull);
+    return CH_OK;
+}
+
+ch_status convhull_3d_move(convhull_3d_hull *hull, const int *indices, ch_vertex *const points, const int n)
+{
+    int i, m, *pts;
+
+    /* Take all of the points out first, and only then put them back in their new positions; so that the points that
+     * are being moved are never owned by a face, or picked as candidates, while they are out of place */
+    hull_start_tracking(hull);
+    for (i = 0; i < n; i++)
+        if (indices[i] >= 0 && indices[i] < hull->nPoints && !hull->removed[indices[i]])
+            hull_take_out(hull, indices[i]);
+    pts = hull->ctx->cand;
+    for (i = 0, m = 0; i < n; i++)
+    {
+        if (indices[i] < 0 || indices[i] >= hull->nPoints || !hull->removed[indices[i]])
+            continue;
+        hull_set_point(hull, indices[i], &points[i]);
+        hull->nAlive++;
+        pts[m++] = indices[i];
     }
+    return hull_add(hull, pts, m);
+}
 
-    /* output */
-    if (ERROR)
+void convhull_3d_hull_faces(convhull_3d_hull *hull, int **out_faces, int *nOut_faces)
+{
+    int f, k, n;
+
+    (*out_faces) = NULL;
+    (*nOut_faces) = 0;
+    if (hull->nFaces == 0)
+        return;
+    if (!hull->tracked)
     {
-        (*out_faces) = NULL;
-        (*nOut_faces) = 0;
+        (*out_faces) = hull->ctx->faces;
+        (*nOut_faces) = hull->nFaces;
+        return;
     }
-    else
+    if (hull->nFaces > hull->maxOut)
+    {
+        if (!ch_grow(&hull->out, size_t(MAX(hull->nFaces, 2 * hull->maxOut)) * 3))
+            return;
+        hull->maxOut = MAX(hull->nFaces, 2 * hull->maxOut);
+    }
+    for (f = 0, n = 0; f < hull->owners.nSlots; f++)
+    {
+        if (hull->ctx->faces[f * 3] == -1)
+            continue;
+        for (k = 0; k < 3; k++)
+            hull->out[n * 3 + k] = hull->ctx->faces[f * 3 + k];
+        n++;
+    }
+    (*out_faces) = hull->out;
+    (*nOut_faces) = n;
+}
+
+ch_status convhull_3d_build_ex(ch_vertex *const in_vertices, const int nVert, const convhull_3d_options *options,
+                               int **out_faces, int *nOut_faces)
+{
+    convhull_3d_context *ctx;
+    ch_status status;
+    int *faces;
+    int nFaces;
+
+    (*out_faces) = NULL;
+    (*nOut_faces) = 0;
+    ctx = convhull_3d_context_create();
+    if (ctx == NULL)
+        return CH_ERROR_MEMORY;
+    status = convhull_3d_build_ctx(ctx, in_vertices, nVert, options, &faces, &nFaces);
+    if ((status == CH_OK || status == CH_CANCELLED) && faces != NULL)
     {
-        (*out_faces) = (int *)ch_malloc(size_t(nFaces * d) * sizeof(int));
-        memcpy((*out_faces), faces, size_t(nFaces * d) * sizeof(int));
-        (*nOut_faces) = nFaces;
-    }
-
-    /* clean-up */
-    ch_free(visible_ind);
-    ch_free(points_cf);
-    ch_free(points_s);
-    ch_free(face_s);
-    ch_free(gVec);
-    ch_free(meanp);
-    ch_free(absdist);
-    ch_free(reldist);
-    ch_free(desReldist);
-    ch_free(ind);
-    ch_free(span);
-    ch_free(points);
-    ch_free(faces);
-    ch_free(aVec);
-    ch_free(cf);
-    ch_free(cfi);
-    ch_free(df);
-    ch_free(p_s);
-    ch_free(fVec);
-    ch_free(asfVec);
-    ch_free(bVec);
-    ch_free(A);
+        (*out_faces) = (int *)ch_malloc(size_t(MAX(nFaces, 1) * 3) * sizeof(int));
+        if ((*out_faces) == NULL)
+            status = CH_ERROR_MEMORY;
+        else
+        {
+            memcpy((*out_faces), faces, size_t(nFaces * 3) * sizeof(int));
+            (*nOut_faces) = nFaces;
+        }
+    }
+    convhull_3d_context_destroy(ctx);
+    return status;
+}
+
+void convhull_3d_build(ch_vertex *const in_vertices, const int nVert, int **out_faces, int *nOut_faces)
+{
+    ch_status status;
+
+    status = convhull_3d_build_ex(in_vertices, nVert, NULL, out_faces, nOut_faces);
+
+    /* If you hit this assertion error, then the input vertices do not span all 3 dimensions. Therefore the convex hull cannot be built.
+     * In these cases, reduce the dimensionality of the points and call convhull_nd_build() instead with d<3 */
+    if (status == CH_ERROR_DEGENERATE)
+        CH_THROW("input does not span all 3 dimensions");
+    /* If you hit this assertion error, then a face cannot be properly orientated */
+    if (status == CH_ERROR_NUMERIC)
+        CH_THROW("face cannot be properly orientated");
 }
 
 void convhull_3d_export_obj(ch_vertex *const vertices, const int nVert, int *const faces, const int nFaces,
@@ -1170,7 +4526,8 @@ void extractVerticesFromObjFile(char *const obj_filename, ch_vertex **out_vertic
                         (*out_nVert) = 0;
                         return;
                     }
-                    (*out_vertices)[i][size_t(vertID)] = (CH_FLOAT)atof(vert_char);
+                    if (vertID < 3) /* any further (e.g. colour) components are skipped */
+                        (*out_vertices)[i][size_t(vertID)] = (CH_FLOAT)atof(vert_char);
                     memset(vert_char, 0, 256 * sizeof(char));
                 }
                 prev_char_isDigit = current_char_isDigit;
@@ -1193,37 +4550,380 @@ void extractVerticesFromObjFile(char *const obj_filename, ch_vertex **out_vertic
 void convhull_nd_build(CH_FLOAT *const in_vertices, const int nVert, const int d, int **out_faces, CH_FLOAT **out_cf,
                        CH_FLOAT **out_df, int *nOut_faces)
 {
-    int i, j, k, l, h;
-    int nFaces, p;
-    int *aVec, *faces;
-    CH_FLOAT dfi, v, max_p, min_p;
-    CH_FLOAT *points, *cf, *cfi, *df, *p_s, *span;
+    convhull_nd_build_opt(in_vertices, nVert, d, NULL, out_faces, out_cf, out_df, nOut_faces);
+}
+
+/* The 2-D builder: Andrew's monotone chain, on the points sorted by x (and then by y). The hull is traced
+ * counter-clockwise, so each face (edge) has the outside on its right, as with the N-D builder. The orientation tests
+ * are exact, so collinear and duplicate points are never vertices of the hull, and no noise needs to be added */
+static ch_status convhull_2d_build(CH_FLOAT *const in_vertices, const int nVert, const convhull_3d_options *options,
+                                   int **out_faces, CH_FLOAT **out_cf, CH_FLOAT **out_df, int *nOut_faces)
+{
+    static const CH_FLOAT dirs[8][2] = { { 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 },
+                                         { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 } };
+    int i, j, k, a, m, lo, nOct, nFaces, nLower, ties;
+    int ext[8];
+    int *hull;
+    CH_FLOAT ex, ey, len, maxabs, tol, dist;
+    CH_FLOAT extv[8], oct[8][3];
+    CH_FLOAT *pts;
+    const CH_FLOAT *pa, *pb;
+    key_w_idx *keys;
+
+    /* Akl-Toussaint heuristic (see kdop_cull()): the points strictly inside the octagon spanned by the extreme points
+     * along the x, y, x+y and x-y axes cannot be vertices of the hull. The directions are in counter-clockwise order,
+     * so the octagon is too */
+    nOct = 0;
+    if (options->kdop_directions > 0)
+    {
+        for (a = 0; a < 8; a++)
+        {
+            ext[a] = 0;
+            extv[a] = dirs[a][0] * in_vertices[0] + dirs[a][1] * in_vertices[1];
+        }
+        for (i = 1; i < nVert; i++)
+        {
+            for (a = 0; a < 8; a++)
+            {
+                dist = dirs[a][0] * in_vertices[i * 2] + dirs[a][1] * in_vertices[i * 2 + 1];
+                if (dist > extv[a])
+                {
+                    extv[a] = dist;
+                    ext[a] = i;
+                }
+            }
+        }
+        maxabs = 0.0;
+        for (a = 0, k = 0; a < 8; a++)
+        {
+            pa = &in_vertices[ext[a] * 2];
+            pb = &in_vertices[ext[k > 0 ? k - 1 : 7] * 2];
+            if (k == 0 || pa[0] != pb[0] || pa[1] != pb[1])
+                ext[k++] = ext[a];
+            maxabs = MAX(maxabs, MAX(fabs(pa[0]), fabs(pa[1])));
+        }
+        if (k > 1 && in_vertices[ext[k - 1] * 2] == in_vertices[ext[0] * 2] &&
+            in_vertices[ext[k - 1] * 2 + 1] == in_vertices[ext[0] * 2 + 1])
+            k--;
+
+        /* Its edges, as outward unit normals and offsets; a point is only culled if it is further than 'tol' inside
+         * every one of them */
+        tol = CH_KDOP_TOL * maxabs;
+        if (k >= 3)
+        {
+            for (nOct = 0; nOct < k; nOct++)
+            {
+                pa = &in_vertices[ext[nOct] * 2];
+                pb = &in_vertices[ext[(nOct + 1) % k] * 2];
+                ex = pb[0] - pa[0];
+                ey = pb[1] - pa[1];
+                len = sqrt(ex * ex + ey * ey);
+                oct[nOct][0] = ey / len;
+                oct[nOct][1] = -ex / len;
+                oct[nOct][2] = -(oct[nOct][0] * pa[0] + oct[nOct][1] * pa[1]) + tol;
+            }
+        }
+    }
 
-    assert(d <= CONVHULL_ND_MAX_DIMENSIONS);
+    /* The surviving points */
+    keys = (key_w_idx *)ch_malloc(size_t(nVert) * 2 * sizeof(key_w_idx));
+    if (keys == NULL)
+        return CH_ERROR_MEMORY;
+    for (i = 0, m = 0; i < nVert; i++)
+    {
+        for (a = 0; a < nOct; a++)
+            if (oct[a][0] * in_vertices[i * 2] + oct[a][1] * in_vertices[i * 2 + 1] + oct[a][2] >= 0.0)
+                break;
+        if (a == nOct && nOct > 0)
+            continue;
+        keys[m].val = float_key(in_vertices[i * 2] == 0.0 ? (CH_FLOAT)0.0 : in_vertices[i * 2]);
+        keys[m++].idx = i;
+    }
 
-    /* Solution not possible... */
-    if (nVert <= d || in_vertices == NULL)
+    /* Sort them by their y coordinates and then (stably) by their x coordinates; although the first sort is only
+     * needed if any of the x coordinates are tied. Zeros are keyed as +0, so that -0 and +0 are tied too */
+    sort_keys(keys, keys + m, m, options->num_threads);
+    for (i = 1, ties = 0; i < m && !ties; i++)
+        ties = keys[i].val == keys[i - 1].val;
+    if (ties)
     {
-        (*out_faces) = NULL;
-        (*nOut_faces) = 0;
+        for (i = 0; i < m; i++)
+        {
+            j = keys[i].idx;
+            keys[i].val = float_key(in_vertices[j * 2 + 1] == 0.0 ? (CH_FLOAT)0.0 : in_vertices[j * 2 + 1]);
+        }
+        sort_keys(keys, keys + m, m, options->num_threads);
+        for (i = 0; i < m; i++)
+        {
+            j = keys[i].idx;
+            keys[i].val = float_key(in_vertices[j * 2] == 0.0 ? (CH_FLOAT)0.0 : in_vertices[j * 2]);
+        }
+        sort_keys(keys, keys + m, m, options->num_threads);
+    }
+
+    /* Copied in that order, so that the chain runs through them in memory order */
+    pts = (CH_FLOAT *)ch_malloc(size_t(MAX(m, 1)) * 2 * sizeof(CH_FLOAT));
+    hull = (int *)ch_malloc(size_t(MAX(2 * m, 1)) * sizeof(int));
+    if (pts == NULL || hull == NULL)
+    {
+        ch_free(keys);
+        ch_free(pts);
+        ch_free(hull);
+        return CH_ERROR_MEMORY;
+    }
+    for (i = 0; i < m; i++)
+    {
+        pts[i * 2] = in_vertices[keys[i].idx * 2];
+        pts[i * 2 + 1] = in_vertices[keys[i].idx * 2 + 1];
+    }
+
+    /* The lower hull from left to right, then the upper hull from right to left. A point is only kept while it makes
+     * a strict left turn */
+    k = 0;
+    for (i = 0; i < m; i++)
+    {
+        while (k >= 2 && orient2d(pts + hull[k - 2] * 2, pts + hull[k - 1] * 2, pts + i * 2) <= 0)
+            k--;
+        hull[k++] = i;
+    }
+    nLower = k - 1; /* number of edges on the lower chain */
+    for (i = m - 2, lo = k + 1; i >= 0; i--)
+    {
+        while (k >= lo && orient2d(pts + hull[k - 2] * 2, pts + hull[k - 1] * 2, pts + i * 2) <= 0)
+            k--;
+        hull[k++] = i;
+    }
+    nFaces = k - 1; /* the first point is also the last */
+
+    /* The input vertices do not span both dimensions, if so. Therefore the convex hull cannot be built */
+    if (nFaces < 3)
+    {
+        ch_free(keys);
+        ch_free(pts);
+        ch_free(hull);
+        return CH_ERROR_DEGENERATE;
+    }
+
+    /* output; the outward normal of edge (a, b) is (b - a) turned clockwise. The lower hull is the lower chain, less
+     * any vertical edge at its ends */
+    (*out_faces) = (int *)ch_malloc(size_t(nFaces * 2) * sizeof(int));
+    if (out_cf != NULL)
+        (*out_cf) = (CH_FLOAT *)ch_malloc(size_t(nFaces * 2) * sizeof(CH_FLOAT));
+    if (out_df != NULL)
+        (*out_df) = (CH_FLOAT *)ch_malloc(size_t(nFaces) * sizeof(CH_FLOAT));
+    if ((*out_faces) == NULL || (out_cf != NULL && (*out_cf) == NULL) || (out_df != NULL && (*out_df) == NULL))
+    {
+        ch_free(keys);
+        ch_free(pts);
+        ch_free(hull);
+        return CH_ERROR_MEMORY; /* (the outputs are freed by the caller) */
+    }
+    for (i = 0, j = 0; i < nFaces; i++)
+    {
+        pa = pts + hull[i] * 2;
+        pb = pts + hull[i + 1] * 2;
+        if (options->lower_hull && (i >= nLower || pb[0] == pa[0]))
+            continue;
+        (*out_faces)[j * 2] = keys[hull[i]].idx;
+        (*out_faces)[j * 2 + 1] = keys[hull[i + 1]].idx;
+        ex = pb[0] - pa[0];
+        ey = pb[1] - pa[1];
+        len = sqrt(ex * ex + ey * ey);
         if (out_cf != NULL)
-            (*out_cf) = NULL;
+        {
+            (*out_cf)[j * 2] = ey / len;
+            (*out_cf)[j * 2 + 1] = -ex / len;
+        }
         if (out_df != NULL)
-            (*out_df) = NULL;
-        return;
+            (*out_df)[j] = (ex * pa[1] - ey * pa[0]) / len;
+        j++;
+    }
+    (*nOut_faces) = j;
+    ch_free(keys);
+    ch_free(pts);
+    ch_free(hull);
+    return CH_OK;
+}
+
+/* Copies the coordinates of the d vertices of 'face' to p_s (d x d). Vertex 'top' is the point at infinity above the
+ * points (along the last dimension), which is stood in for by another vertex of the face, lifted by 'lift' */
+template <int D>
+static void face_points_nd(const int nd, const CH_FLOAT *points, const int *face, const int top, const CH_FLOAT lift,
+                           CH_FLOAT *p_s)
+{
+    const int d = D > 0 ? D : nd;
+    int j, k;
+    for (j = 0; j < d; j++)
+    {
+        if (face[j] == top)
+        {
+            for (k = 0; k < d; k++)
+                p_s[j * d + k] = points[face[j == 0 ? 1 : 0] * (d + 1) + k];
+            p_s[j * d + d - 1] += lift;
+        }
+        else
+        {
+            for (k = 0; k < d; k++)
+                p_s[j * d + k] = points[face[j] * (d + 1) + k];
+        }
+    }
+}
+
+/* Orients face f so that the 'interior' point is below it, by reversing the order of its last two vertices and the
+ * sign of its plane if need be. Returns 0 if the interior point lies on the face */
+template <int D>
+static int face_orient_nd(const int nd, int *faces, CH_FLOAT *pl, const int ld, const int f, const CH_FLOAT *interior)
+{
+    const int d = D > 0 ? D : nd;
+    int j, tmp;
+    CH_FLOAT dist;
+
+    dist = pl[d * ld + f];
+    for (j = 0; j < d; j++)
+        dist += interior[j] * pl[j * ld + f];
+    if (dist > 0.0)
+    {
+        tmp = faces[f * d + d - 1];
+        faces[f * d + d - 1] = faces[f * d + d - 2];
+        faces[f * d + d - 2] = tmp;
+        for (j = 0; j < d + 1; j++)
+            pl[j * ld + f] = -pl[j * ld + f];
     }
+    /* If this fails, then the face cannot be properly orientated and building the convex hull is likely impossible */
+    else if (dist == 0.0)
+        return 0;
+    return 1;
+}
+
+/* The working memory of the N-D builder, which is all released by nd_ws_free() however the build ends. The per-face
+ * buffers grow together (see nd_reserve_faces()), as do those that hold the horizon of an insertion (see
+ * nd_reserve_ridges()), so that the main loop only allocates when one of them runs out of room */
+typedef struct _ch_nd_workspace
+{
+    CH_FLOAT *points; /* noisy copy of the input vertices, with a last column of ones; flat: (nVert+1) x (d+1) */
+    int *prest; /* the points that are not on the initial simplex; nRest x 1 */
+    CH_FLOAT *reldist, *desReldist; /* their relative distances from the centre, and these sorted; nRest x 1 */
+    int *ind; /* their order; nVert x 1 */
+    int *pleft; /* the points left, in insertion order; nRest x 1 */
+    key_w_idx *order_ws; /* scratch space for insertion_order(); 2*nVert x 1 */
+
+    int maxFaces; /* capacity of the per-face buffers */
+    int *faces, *fnbr; /* vertices of each face, and the face opposite each of them; flat: maxFaces x d */
+    ch_planes planes; /* plane coefficients of the faces (see ch_planes) */
+    CH_FLOAT *points_cf; /* distances of the current point from the faces; maxFaces x 1 */
+    uint64_t *vmask; /* faces that the current point is above, one bit each; (maxFaces+63)/64 x 1 */
+    int *visible, *ffree, *fremap; /* visible faces, free face slots, and the new slot of each face; maxFaces x 1 */
+
+    int maxRidges; /* capacity of the horizon buffers */
+    int *horizon; /* ridges of the horizon; flat: maxRidges x (d-1) */
+    int *hz_face, *hz_slot, *newf; /* face beyond each ridge, the ridge's slot in it, and the new face on it */
+    ridge_key *keys; /* scratch space for link_cone(); maxRidges*(d-1) x 1 */
+} ch_nd_workspace;
+
+/* Makes sure that the per-face buffers of 'ws' can hold at least 'n' faces, keeping the first 'nSlots'. Returns 0 if
+ * the memory cannot be had (in which case the buffers that did grow keep their contents, and may be grown again) */
+static int nd_reserve_faces(ch_nd_workspace *ws, const int d, const int nSlots, const int n)
+{
+    int m;
+    if (n <= ws->maxFaces)
+        return 1;
+    m = MAX(n, 2 * ws->maxFaces);
+    if (!ch_grow(&ws->faces, size_t(m) * size_t(d)) || !ch_grow(&ws->fnbr, size_t(m) * size_t(d)) ||
+        !planes_reserve(&ws->planes, d, nSlots, m) || !ch_grow(&ws->points_cf, size_t(m)) ||
+        !ch_grow(&ws->vmask, size_t((m + 63) / 64)) || !ch_grow(&ws->visible, size_t(m)) ||
+        !ch_grow(&ws->ffree, size_t(m)) || !ch_grow(&ws->fremap, size_t(m)))
+        return 0;
+    ws->maxFaces = m;
+    return 1;
+}
+
+/* Makes sure that the horizon buffers of 'ws' can hold at least 'n' ridges. Returns 0 if the memory cannot be had */
+static int nd_reserve_ridges(ch_nd_workspace *ws, const int d, const int n)
+{
+    int m;
+    if (n <= ws->maxRidges)
+        return 1;
+    m = MAX(n, 2 * ws->maxRidges);
+    if (!ch_grow(&ws->horizon, size_t(m) * size_t(d - 1)) || !ch_grow(&ws->hz_face, size_t(m)) ||
+        !ch_grow(&ws->hz_slot, size_t(m)) || !ch_grow(&ws->newf, size_t(m)) ||
+        !ch_grow(&ws->keys, size_t(m) * size_t(d - 1)))
+        return 0;
+    ws->maxRidges = m;
+    return 1;
+}
+
+static void nd_ws_free(ch_nd_workspace *ws)
+{
+    ch_free(ws->points);
+    ch_free(ws->prest);
+    ch_free(ws->reldist);
+    ch_free(ws->desReldist);
+    ch_free(ws->ind);
+    ch_free(ws->pleft);
+    ch_free(ws->order_ws);
+    ch_free(ws->faces);
+    ch_free(ws->fnbr);
+    planes_free(&ws->planes);
+    ch_free(ws->points_cf);
+    ch_free(ws->vmask);
+    ch_free(ws->visible);
+    ch_free(ws->ffree);
+    ch_free(ws->fremap);
+    ch_free(ws->horizon);
+    ch_free(ws->hz_face);
+    ch_free(ws->hz_slot);
+    ch_free(ws->newf);
+    ch_free(ws->keys);
+    memset(ws, 0, sizeof(ch_nd_workspace));
+}
 
-    /* Add noise to the points */
-    points = (CH_FLOAT *)ch_malloc(size_t(nVert * (d + 1)) * sizeof(CH_FLOAT));
+/* The N-D builder, for D dimensions; which are fixed at compile time so that the loops over them may be unrolled (or
+ * for any number of dimensions, nd, if D == 0). With options->lower_hull, only the lower hull (the faces that can be
+ * seen from below, along the last dimension) is built: the initial simplex is then made up of d points that span the
+ * first d-1 dimensions, and of the point at infinity above them; so the upper hull is never built, and the faces through
+ * the point at infinity (which are parallel to the last dimension) are left out of the output. All of its working
+ * memory is taken from 'ws', so that it may return from anywhere (see convhull_nd_build_fixed()). The outputs are only
+ * allocated once the hull has been built (or the build has been stopped); if they cannot all be had, the caller frees
+ * those that were */
+template <int D>
+static ch_status convhull_nd_build_ws(CH_FLOAT *const in_vertices, const int nVert, const int nd,
+                                     const convhull_3d_options *options, ch_nd_workspace *ws, int **out_faces,
+                                     CH_FLOAT **out_cf, CH_FLOAT **out_df, int *nOut_faces)
+{
+    const int d = D > 0 ? D : nd;
+    const int lower = options->lower_hull != 0;
+    const int top = lower ? nVert : -1; /* index of the point at infinity */
+    const int nRest = nVert - d - 1 + (lower ? 1 : 0); /* number of points that are not on the initial simplex */
+    int i, j, k, l, h;
+    int nFaces, p;
+    int aVec[CONVHULL_ND_MAX_DIMENSIONS + 1];
+    int *faces, *fnbr;
+    CH_FLOAT dfi, v, max_p, min_p, lift, dist;
+    double deadline;
+    CH_FLOAT span[CONVHULL_ND_MAX_DIMENSIONS], cfi[CONVHULL_ND_MAX_DIMENSIONS];
+    CH_FLOAT p_s[CONVHULL_ND_MAX_DIMENSIONS * CONVHULL_ND_MAX_DIMENSIONS];
+    CH_FLOAT *points, *pl;
+    ch_status status;
+    int ld;
+
+    /* Solution not possible... */
+    if (nVert <= d || in_vertices == NULL)
+        return CH_OK;
+    deadline = options->time_budget > 0.0 ? ch_clock() + options->time_budget : 0.0;
+
+    /* Add noise to the points (the last row is a placeholder for the point at infinity) */
+    points = ws->points = (CH_FLOAT *)ch_calloc(size_t((nVert + 1) * (d + 1)), sizeof(CH_FLOAT));
+    if (points == NULL)
+        return CH_ERROR_MEMORY;
     for (i = 0; i < nVert; i++)
     {
         for (j = 0; j < d; j++)
-            points[i * (d + 1) + j] = in_vertices[i * d + j] + CH_NOISE_VAL * (CH_FLOAT)rand() / (CH_FLOAT)RAND_MAX;
+            points[i * (d + 1) + j] =
+              in_vertices[i * d + j] + CH_NOISE_VAL * ch_noise(options->seed, uint64_t(i) * uint64_t(d) + uint64_t(j));
         points[i * (d + 1) + d] = 1.0; /* add a last column of ones. Used only for determinant calculation */
     }
 
     /* Find the span */
-    span = (CH_FLOAT *)ch_malloc(size_t(d) * sizeof(CH_FLOAT));
     for (j = 0; j < d; j++)
     {
         max_p = -2.23e+13;
@@ -1234,32 +4934,35 @@ void convhull_nd_build(CH_FLOAT *const in_vertices, const int nVert, const int d
             min_p = MIN(min_p, points[i * (d + 1) + j]);
         }
         span[j] = max_p - min_p;
-        /* If you hit this assertion error, then the input vertices do not span all 'd' dimensions. Therefore the convex hull cannot be built.
+        /* If this fails, then the input vertices do not span all 'd' dimensions. Therefore the convex hull cannot be built.
          * In these cases, reduce the dimensionality of the points and call convhull_nd_build() instead with d<3 */
         if (span[j] < 0.0000001f)
-        {
-            throw std::runtime_error("input vertices do not span all 'd' dimensions");
-        }
+            return CH_ERROR_DEGENERATE;
     }
 
-    /* The initial convex hull is a simplex with (d+1) facets, where d is the number of dimensions */
+    /* The initial convex hull is a simplex with (d+1) facets, where d is the number of dimensions. Its vertices
+     * (aVec) are taken from the extreme points, so that it starts off with a large volume. For the lower hull, its
+     * last vertex is the point at infinity, which stands for the (vertical) faces in place of the upper hull */
     nFaces = (d + 1);
-    faces = (int *)ch_calloc(size_t(nFaces * d), sizeof(int));
-    aVec = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-    for (i = 0; i < nFaces; i++)
-        aVec[i] = i;
-
-    /* Each column of cf contains the coefficients of a plane */
-    cf = (CH_FLOAT *)ch_malloc(size_t(nFaces * d) * sizeof(CH_FLOAT));
-    cfi = (CH_FLOAT *)ch_malloc(size_t(d) * sizeof(CH_FLOAT));
-    df = (CH_FLOAT *)ch_malloc(size_t(nFaces) * sizeof(CH_FLOAT));
-    p_s = (CH_FLOAT *)ch_malloc(size_t(d * d) * sizeof(CH_FLOAT));
+    if (!nd_reserve_faces(ws, d, 0, nFaces))
+        return CH_ERROR_MEMORY;
+    faces = ws->faces;
+    fnbr = ws->fnbr;
+    if (!simplex_extreme(points, d + 1, nVert, lower ? d - 1 : d, aVec))
+        return CH_ERROR_DEGENERATE;
+    if (lower)
+        aVec[d] = top;
+    lift = span[d - 1];
+
+    /* The plane coefficients of the faces (see ch_planes) */
+    pl = ws->planes.data;
+    ld = ws->planes.ld;
     for (i = 0; i < nFaces; i++)
     {
         /* Set the indices of the points defining the face  */
         for (j = 0, k = 0; j < (d + 1); j++)
         {
-            if (aVec[j] != i)
+            if (j != i)
             {
                 faces[i * d + k] = aVec[j];
                 k++;
@@ -1267,35 +4970,21 @@ void convhull_nd_build(CH_FLOAT *const in_vertices, const int nVert, const int d
         }
 
         /* Calculate and store the plane coefficients of the face */
+        face_points_nd<D>(d, points, &faces[i * d], top, lift, p_s);
+        plane_nd<D>(d, p_s, cfi, &dfi);
         for (j = 0; j < d; j++)
-            for (k = 0; k < d; k++)
-                p_s[j * d + k] = points[(faces[i * d + j]) * (d + 1) + k];
-
-        /* Calculate and store the plane coefficients of the face */
-        plane_nd(d, p_s, cfi, &dfi);
-        for (j = 0; j < d; j++)
-            cf[i * d + j] = cfi[j];
-        df[i] = dfi;
+            pl[j * ld + i] = cfi[j];
+        pl[d * ld + i] = dfi;
     }
-    CH_FLOAT *A;
-    int *bVec, *fVec;
+    CH_FLOAT A[(CONVHULL_ND_MAX_DIMENSIONS + 1) * (CONVHULL_ND_MAX_DIMENSIONS + 1)];
     int face_tmp[2];
 
-    /* Check to make sure that faces are correctly oriented */
-    bVec = (int *)ch_malloc(size_t(d + 1) * sizeof(int));
-    for (i = 0; i < d + 1; i++)
-        bVec[i] = i;
-
-    /* A contains the coordinates of the points forming a simplex */
-    A = (CH_FLOAT *)ch_calloc(size_t((d + 1) * (d + 1)), sizeof(CH_FLOAT));
-    fVec = (int *)ch_malloc(size_t(d + 1) * sizeof(int));
-    for (k = 0; k < (d + 1); k++)
+    /* Check to make sure that faces are correctly oriented. A contains the coordinates of the points forming a
+     * simplex */
+    for (k = 0; k < (lower ? 0 : d + 1); k++)
     {
         /* Get the point that is not on the current face (point p) */
-        for (i = 0; i < d; i++)
-            fVec[i] = faces[k * d + i];
-        sort_int(fVec, NULL, NULL, d, 0); /* sort accending */
-        p = k;
+        p = aVec[k];
         for (i = 0; i < d; i++)
             for (j = 0; j < (d + 1); j++)
                 A[i * (d + 1) + j] = points[(faces[k * d + i]) * (d + 1) + j];
@@ -1307,7 +4996,7 @@ void convhull_nd_build(CH_FLOAT *const in_vertices, const int nVert, const int d
         if (d == 3)
             v = det_4x4(A);
         else
-            v = det_NxN(A, d + 1);
+            v = det_nd<(D > 0 ? D + 1 : 0)>(d + 1, A);
 
         /* Orient so that each point on the original simplex can't see the opposite face */
         if (v < 0)
@@ -1319,520 +5008,843 @@ void convhull_nd_build(CH_FLOAT *const in_vertices, const int nVert, const int d
                 faces[k * d + d - j - 1] = face_tmp[1 - j];
 
             /* Modify the plane coefficients of the properly oriented faces */
-            for (j = 0; j < d; j++)
-                cf[k * d + j] = -cf[k * d + j];
-            df[k] = -df[k];
-            for (i = 0; i < d; i++)
-                for (j = 0; j < (d + 1); j++)
-                    A[i * (d + 1) + j] = points[(faces[k * d + i]) * (d + 1) + j];
-            for (; i < (d + 1); i++)
-                for (j = 0; j < (d + 1); j++)
-                    A[i * (d + 1) + j] = points[p * (d + 1) + j];
+            for (j = 0; j < d + 1; j++)
+                pl[j * ld + k] = -pl[j * ld + k];
         }
     }
 
+    /* The centroid of the initial simplex stays strictly inside the hull, so it is a fixed reference point for
+     * orienting the new faces. For the lower hull, it is the centroid of the finite vertices, lifted above them; by
+     * which the faces of the initial simplex are oriented too */
+    CH_FLOAT interior[CONVHULL_ND_MAX_DIMENSIONS] = { 0 };
+    for (i = 0; i < d + 1; i++)
+        for (j = 0; j < d && aVec[i] != top; j++)
+            interior[j] += points[aVec[i] * (d + 1) + j] / (CH_FLOAT)(lower ? d : d + 1);
+    if (lower)
+    {
+        interior[d - 1] += lift;
+        for (k = 0; k < d + 1; k++)
+            if (!face_orient_nd<D>(d, faces, pl, ld, k, interior))
+                return CH_ERROR_NUMERIC;
+    }
+
+    /* Face neighbours of the initial simplex. Face k is made up of all of the points except aVec[k], so the face
+     * opposite to its j'th vertex is the face that the vertex is missing from */
+    for (k = 0; k < nFaces * d; k++)
+        for (j = 0; j < d + 1; j++)
+            if (aVec[j] == faces[k])
+                fnbr[k] = j;
+
+    /* The remaining points (i.e. all but those of the initial simplex) */
+    int *prest;
+    prest = ws->prest = (int *)ch_malloc(size_t(MAX(nRest, 1)) * sizeof(int));
+    if (prest == NULL)
+        return CH_ERROR_MEMORY;
+    for (i = 0, k = 0; i < nVert; i++)
+    {
+        for (j = 0; j < d + 1; j++)
+            if (aVec[j] == i)
+                break;
+        if (j == d + 1)
+            prest[k++] = i;
+    }
+
     /* Coordinates of the center of the point set */
-    CH_FLOAT *meanp, *reldist, *desReldist, *absdist;
-    meanp = (CH_FLOAT *)ch_calloc(size_t(d), sizeof(CH_FLOAT));
-    for (i = d + 1; i < nVert; i++)
+    CH_FLOAT meanp[CONVHULL_ND_MAX_DIMENSIONS] = { 0 };
+    CH_FLOAT *reldist, *desReldist;
+    for (k = 0; k < nRest; k++)
         for (j = 0; j < d; j++)
-            meanp[j] += points[i * (d + 1) + j];
+            meanp[j] += points[prest[k] * (d + 1) + j];
     for (j = 0; j < d; j++)
-        meanp[j] = meanp[j] / (CH_FLOAT)(nVert - d - 1);
-
-    /* Absolute distance of points from the center */
-    absdist = (CH_FLOAT *)ch_malloc(size_t(nVert - d - 1) * size_t(d) * sizeof(CH_FLOAT));
-    for (i = d + 1, k = 0; i < nVert; i++, k++)
-        for (j = 0; j < d; j++)
-            absdist[k * d + j] = (points[i * (d + 1) + j] - meanp[j]) / span[j];
-
-    /* Relative distance of points from the center */
-    reldist = (CH_FLOAT *)ch_calloc(size_t(nVert - d - 1), sizeof(CH_FLOAT));
-    desReldist = (CH_FLOAT *)ch_malloc(size_t(nVert - d - 1) * sizeof(CH_FLOAT));
-    for (i = 0; i < (nVert - d - 1); i++)
+        meanp[j] = meanp[j] / (CH_FLOAT)nRest;
+
+    /* Relative distance of points from the center, from their absolute distances along each dimension */
+    reldist = ws->reldist = (CH_FLOAT *)ch_calloc(size_t(MAX(nRest, 1)), sizeof(CH_FLOAT));
+    desReldist = ws->desReldist = (CH_FLOAT *)ch_malloc(size_t(MAX(nRest, 1)) * sizeof(CH_FLOAT));
+    if (reldist == NULL || desReldist == NULL)
+        return CH_ERROR_MEMORY;
+    for (i = 0; i < nRest; i++)
+    {
         for (j = 0; j < d; j++)
-            reldist[i] += pow(absdist[i * d + j], 2.0);
+        {
+            dist = (points[prest[i] * (d + 1) + j] - meanp[j]) / span[j];
+            reldist[i] += pow(dist, 2.0);
+        }
+    }
 
-    /* Sort from maximum to minimum relative distance */
-    int num_pleft, cnt;
+    int num_pleft, next;
     int *ind, *pleft;
-    ind = (int *)ch_malloc(size_t(nVert - d - 1) * sizeof(int));
-    pleft = (int *)ch_malloc(size_t(nVert - d - 1) * sizeof(int));
-    sort_float(reldist, desReldist, ind, (nVert - d - 1), 1);
-
-    /* Initialize the vector of points left. The points with the larger relative
-     distance from the center are scanned first. */
-    num_pleft = (nVert - d - 1);
-    for (i = 0; i < num_pleft; i++)
-        pleft[i] = ind[i] + d + 1;
-
-    /* Loop over all remaining points that are not deleted. Deletion of points
-     occurs every #iter2del# iterations of this while loop */
-    memset(A, 0, size_t(d + 1) * size_t(d + 1) * sizeof(CH_FLOAT));
-
-    /* cnt is equal to the points having been selected without deletion of
-     nonvisible points (i.e. points inside the current convex hull) */
-    cnt = 0;
-
-    /* The main loop for the quickhull algorithm */
-    CH_FLOAT detA;
-    CH_FLOAT *points_cf, *points_s;
-    int *visible_ind, *visible, *nonvisible_faces, *f0, *face_s, *u, *gVec, *horizon, *hVec, *pp, *hVec_mem_face;
-    int num_visible_ind, num_nonvisible_faces, n_newfaces, count, vis;
-    int f0_sum, u_len, start, num_p, index, horizon_size1;
-    int ERROR;
-    ERROR = 0;
-    u = horizon = NULL;
+    ind = ws->ind = (int *)ch_malloc(size_t(nVert) * sizeof(int));
+    pleft = ws->pleft = (int *)ch_malloc(size_t(MAX(nRest, 1)) * sizeof(int));
+    if (ind == NULL || pleft == NULL)
+        return CH_ERROR_MEMORY;
+    num_pleft = nRest;
+    if (options->insertion_order == CH_ORDER_MORTON || options->insertion_order == CH_ORDER_BRIO)
+    {
+        /* Initialize the vector of points left, in the insertion order */
+        ws->order_ws = (key_w_idx *)ch_malloc(size_t(nVert) * 2 * sizeof(key_w_idx));
+        if (ws->order_ws == NULL)
+            return CH_ERROR_MEMORY;
+        insertion_order(points, d + 1, nVert, d, options->insertion_order == CH_ORDER_BRIO, options->seed, 1,
+                        ws->order_ws, ind);
+        for (i = 0, k = 0; i < nVert; i++)
+        {
+            for (j = 0; j < d + 1; j++)
+                if (aVec[j] == ind[i])
+                    break;
+            if (j == d + 1)
+                pleft[k++] = ind[i];
+        }
+    }
+    else
+    {
+        /* Sort from maximum to minimum relative distance */
+        if (!sort_float(reldist, desReldist, ind, nRest, 1))
+            return CH_ERROR_MEMORY;
+
+        /* Initialize the vector of points left. The points with the larger relative
+         distance from the center are scanned first. */
+        for (i = 0; i < num_pleft; i++)
+            pleft[i] = prest[ind[i]];
+    }
+
+    /* The main loop for the quickhull algorithm. As in convhull_3d_build(), deleted faces are marked with
+     * faces[f*d] == -1 and their slots are reused by the new faces, and the nSlots face slots are only compacted once
+     * fewer than half of them are in use. The loop stops early (with the hull of the points taken up so far) if the
+     * build runs out of time or is cancelled */
+    CH_FLOAT points_s[CONVHULL_ND_MAX_DIMENSIONS];
+    ch_visibility_kernel visibility;
+    int *visible, *horizon, *hz_face, *hz_slot, *newf;
+    int num_visible_ind, n_newfaces, count, vis, g;
+    int horizon_size1, nSlots, nFree;
     nFaces = d + 1;
-    visible_ind = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-    points_cf = (CH_FLOAT *)ch_malloc(size_t(nFaces) * sizeof(CH_FLOAT));
-    points_s = (CH_FLOAT *)ch_malloc(size_t(d) * sizeof(CH_FLOAT));
-    face_s = (int *)ch_malloc(size_t(d) * sizeof(int));
-    gVec = (int *)ch_malloc(size_t(d) * sizeof(int));
-    while ((num_pleft > 0))
-    {
-        /* i is the first point of the points left */
-        i = pleft[0];
-
-        /* Delete the point selected */
-        for (j = 0; j < num_pleft - 1; j++)
-            pleft[j] = pleft[j + 1];
-        num_pleft--;
-        if (num_pleft == 0)
-            ch_free(pleft);
-        else
-            pleft = (int *)ch_realloc(pleft, size_t(num_pleft) * sizeof(int));
+    nSlots = nFaces;
+    nFree = 0;
+    status = CH_OK;
+    visibility = visibility_kernel();
+    for (next = 0; next < num_pleft; next++)
+    {
+        if ((deadline > 0.0 || options->cancel != NULL) && ch_stopped(deadline, options))
+        {
+            status = CH_CANCELLED;
+            break;
+        }
 
-        /* Update point selection counter */
-        cnt++;
+        /* i is the next of the points left */
+        i = pleft[next];
 
-        /* find visible faces */
+        /* find visible faces (none of the deleted faces are, see below) */
         for (j = 0; j < d; j++)
             points_s[j] = points[i * (d + 1) + j];
-        points_cf = (CH_FLOAT *)ch_realloc(points_cf, size_t(nFaces) * sizeof(CH_FLOAT));
-        visible_ind = (int *)ch_realloc(visible_ind, size_t(nFaces) * sizeof(int));
-#ifdef CONVHULL_3D_USE_CBLAS
-#ifdef CONVHULL_3D_USE_SINGLE_PRECISION
-        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, 1, nFaces, d, 1.0f, points_s, d, cf, d, 0.0f, points_cf,
-                    nFaces);
-#else
-        cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasTrans, 1, nFaces, d, 1.0, points_s, d, cf, d, 0.0, points_cf,
-                    nFaces);
-#endif
-#else
-        for (j = 0; j < nFaces; j++)
-        {
-            points_cf[j] = 0;
-            for (k = 0; k < d; k++)
-                points_cf[j] += points_s[k] * cf[j * d + k];
-        }
-#endif
+        visibility(d, pl, ld, points_s, 0, nSlots, ws->points_cf, ws->vmask);
+        visible = ws->visible;
         num_visible_ind = 0;
-        for (j = 0; j < nFaces; j++)
+        for (j = 0; j < nSlots; j++)
         {
-            if (points_cf[j] + df[j] > 0.0)
-            {
-                num_visible_ind++; /* will sum to 0 if none are visible */
-                visible_ind[j] = 1;
-            }
-            else
-                visible_ind[j] = 0;
+            if (ws->vmask[j >> 6] == 0)
+                j |= 63; /* skip the rest of this word */
+            else if ((ws->vmask[j >> 6] >> (j & 63)) & 1)
+                visible[num_visible_ind++] = j; /* visible face indices */
         }
-        num_nonvisible_faces = nFaces - num_visible_ind;
 
         /* proceed if there are any visible faces */
         if (num_visible_ind != 0)
         {
-            /* Find visible face indices */
-            visible = (int *)ch_malloc(size_t(num_visible_ind) * sizeof(int));
-            for (j = 0, k = 0; j < nFaces; j++)
-            {
-                if (visible_ind[j] == 1)
-                {
-                    visible[k] = j;
-                    k++;
-                }
-            }
-
-            /* Find nonvisible faces */
-            nonvisible_faces = (int *)ch_malloc(size_t(num_nonvisible_faces * d) * sizeof(int));
-            f0 = (int *)ch_malloc(size_t(num_nonvisible_faces * d) * sizeof(int));
-            for (j = 0, k = 0; j < nFaces; j++)
-            {
-                if (visible_ind[j] == 0)
-                {
-                    for (l = 0; l < d; l++)
-                        nonvisible_faces[k * d + l] = faces[j * d + l];
-                    k++;
-                }
-            }
-
-            /* Create horizon (count is the number of the edges of the horizon) */
+            /* Create horizon (count is the number of the ridges of the horizon). A ridge of a visible face is on the
+             * horizon if the face on the other side of it is nonvisible */
+            if (!nd_reserve_ridges(ws, d, num_visible_ind * d))
+                return CH_ERROR_MEMORY;
+            horizon = ws->horizon;
+            hz_face = ws->hz_face;
+            hz_slot = ws->hz_slot;
             count = 0;
             for (j = 0; j < num_visible_ind; j++)
             {
-                /* visible face */
                 vis = visible[j];
                 for (k = 0; k < d; k++)
-                    face_s[k] = faces[vis * d + k];
-                sort_int(face_s, NULL, NULL, d, 0);
-                ismember(nonvisible_faces, face_s, f0, num_nonvisible_faces * d, d);
-                u_len = 0;
-
-                /* u are the nonvisible faces connected to the face v, if any */
-                for (k = 0; k < num_nonvisible_faces; k++)
                 {
-                    f0_sum = 0;
+                    g = fnbr[vis * d + k];
+                    if (g == -1 || ((ws->vmask[g >> 6] >> (g & 63)) & 1))
+                        continue;
+                    for (l = 0, h = 0; l < d; l++)
+                        if (l != k)
+                            horizon[count * (d - 1) + h++] = faces[vis * d + l];
+                    hz_face[count] = g;
+                    hz_slot[count] = -1;
                     for (l = 0; l < d; l++)
-                        f0_sum += f0[k * d + l];
-                    if (f0_sum == d - 1)
-                    {
-                        u_len++;
-                        if (u_len == 1)
-                            u = (int *)ch_malloc(size_t(u_len) * sizeof(int));
-                        else
-                            u = (int *)ch_realloc(u, size_t(u_len) * sizeof(int));
-                        u[u_len - 1] = k;
-                    }
-                }
-                for (k = 0; k < u_len; k++)
-                {
-                    /* The boundary between the visible face v and the k(th) nonvisible face connected to the face v forms part of the horizon */
+                        if (fnbr[g * d + l] == vis)
+                            hz_slot[count] = l;
+                    if (hz_slot[count] == -1)
+                        return CH_ERROR_NUMERIC; /* the faces no longer fit together (e.g. after rounding) */
                     count++;
-                    if (count == 1)
-                        horizon = (int *)ch_malloc(size_t(count * (d - 1)) * sizeof(int));
-                    else
-                        horizon = (int *)ch_realloc(horizon, size_t(count * (d - 1)) * sizeof(int));
-                    for (l = 0; l < d; l++)
-                        gVec[l] = nonvisible_faces[u[k] * d + l];
-                    for (l = 0, h = 0; l < d; l++)
-                    {
-                        if (f0[u[k] * d + l])
-                        {
-                            horizon[(count - 1) * (d - 1) + h] = gVec[l];
-                            h++;
-                        }
-                    }
                 }
-                if (u_len != 0)
-                    ch_free(u);
             }
             horizon_size1 = count;
-            for (j = 0, l = 0; j < nFaces; j++)
+
+            /* Delete the visible faces; their slots go on the free list. A deleted face is given a plane that no point
+             * can be above */
+            for (j = 0; j < num_visible_ind; j++)
             {
-                if (!visible_ind[j])
-                {
-                    /* Delete visible faces */
-                    for (k = 0; k < d; k++)
-                        faces[l * d + k] = faces[j * d + k];
-
-                    /* Delete the corresponding plane coefficients of the faces */
-                    for (k = 0; k < d; k++)
-                        cf[l * d + k] = cf[j * d + k];
-                    df[l] = df[j];
-                    l++;
-                }
+                vis = visible[j];
+                faces[vis * d] = -1;
+                for (k = 0; k < d; k++)
+                    pl[k * ld + vis] = 0.0;
+                pl[d * ld + vis] = -1.0;
+                ws->ffree[nFree++] = vis;
             }
 
             /* Update the number of faces */
             nFaces = nFaces - num_visible_ind;
-            faces = (int *)ch_realloc(faces, size_t(nFaces * d) * sizeof(int));
-            cf = (CH_FLOAT *)ch_realloc(cf, size_t(nFaces * d) * sizeof(CH_FLOAT));
-            df = (CH_FLOAT *)ch_realloc(df, size_t(nFaces) * sizeof(CH_FLOAT));
-
-            /* start is the first row of the new faces */
-            start = nFaces;
 
-            /* Add faces connecting horizon to the new point */
+            /* Make room for the new faces, within the face budget (if there is one) */
             n_newfaces = horizon_size1;
+            if (options->max_faces > 0 && nFaces + n_newfaces > options->max_faces)
+                return CH_ERROR_FACE_BUDGET;
+            if (!nd_reserve_faces(ws, d, nSlots, nSlots + MAX(n_newfaces - nFree, 0)))
+                return CH_ERROR_MEMORY;
+            faces = ws->faces;
+            fnbr = ws->fnbr;
+            pl = ws->planes.data;
+            ld = ws->planes.ld;
+
+            /* Add faces connecting horizon to the new point, in the free slots first */
+            newf = ws->newf;
             for (j = 0; j < n_newfaces; j++)
             {
+                g = nFree > 0 ? ws->ffree[--nFree] : nSlots++;
+                newf[j] = g;
                 nFaces++;
-                faces = (int *)ch_realloc(faces, size_t(nFaces * d) * sizeof(int));
-                cf = (CH_FLOAT *)ch_realloc(cf, size_t(nFaces * d) * sizeof(CH_FLOAT));
-                df = (CH_FLOAT *)ch_realloc(df, size_t(nFaces) * sizeof(CH_FLOAT));
                 for (k = 0; k < d - 1; k++)
-                    faces[(nFaces - 1) * d + k] = horizon[j * (d - 1) + k];
-                faces[(nFaces - 1) * d + (d - 1)] = i;
+                    faces[g * d + k] = horizon[j * (d - 1) + k];
+                faces[g * d + (d - 1)] = i;
 
                 /* Calculate and store appropriately the plane coefficients of the faces */
+                face_points_nd<D>(d, points, &faces[g * d], top, lift, p_s);
+                plane_nd<D>(d, p_s, cfi, &dfi);
                 for (k = 0; k < d; k++)
-                    for (l = 0; l < d; l++)
-                        p_s[k * d + l] = points[(faces[size_t((nFaces - 1) * d + k)]) * (d + 1) + l];
-                plane_nd(d, p_s, cfi, &dfi);
-                for (k = 0; k < d; k++)
-                    cf[(nFaces - 1) * d + k] = cfi[k];
-                df[(nFaces - 1)] = dfi;
-                if (nFaces > CH_MAX_NUM_FACES)
-                {
-                    ERROR = 1;
-                    nFaces = 0;
-                    break;
-                }
+                    pl[k * ld + g] = cfi[k];
+                pl[d * ld + g] = dfi;
             }
 
-            /* Orient each new face properly */
-            hVec = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-            hVec_mem_face = (int *)ch_malloc(size_t(nFaces) * sizeof(int));
-            for (j = 0; j < nFaces; j++)
-                hVec[j] = j;
-            for (k = start; k < nFaces; k++)
-            {
-                for (j = 0; j < d; j++)
-                    face_s[j] = faces[k * d + j];
-                sort_int(face_s, NULL, NULL, d, 0);
-                ismember(hVec, face_s, hVec_mem_face, nFaces, d);
-                num_p = 0;
-                for (j = 0; j < nFaces; j++)
-                    if (!hVec_mem_face[j])
-                        num_p++;
-                pp = (int *)ch_malloc(size_t(num_p) * sizeof(int));
-                for (j = 0, l = 0; j < nFaces; j++)
-                {
-                    if (!hVec_mem_face[j])
-                    {
-                        pp[l] = hVec[j];
-                        l++;
-                    }
-                }
-                index = 0;
-                detA = 0.0;
-
-                /* While new point is coplanar, choose another point */
-                while (detA == 0.0)
-                {
-                    for (j = 0; j < d; j++)
-                        for (l = 0; l < d + 1; l++)
-                            A[j * (d + 1) + l] = points[(faces[k * d + j]) * (d + 1) + l];
-                    for (; j < d + 1; j++)
-                        for (l = 0; l < d + 1; l++)
-                            A[j * (d + 1) + l] = points[pp[index] * (d + 1) + l];
-                    index++;
-                    if (d == 3)
-                        detA = det_4x4(A);
-                    else
-                        detA = det_NxN((CH_FLOAT *)A, d + 1);
-                }
+            /* Orient each new face properly, so that the interior point is below it */
+            for (l = 0; l < n_newfaces; l++)
+                if (!face_orient_nd<D>(d, faces, pl, ld, newf[l], interior))
+                    return CH_ERROR_NUMERIC;
 
-                /* Orient faces so that each point on the original simplex can't see the opposite face */
-                if (detA < 0.0)
-                {
-                    /* If orientation is improper, reverse the order to change the volume sign */
-                    for (j = 0; j < 2; j++)
-                        face_tmp[j] = faces[k * d + d - j - 1];
-                    for (j = 0; j < 2; j++)
-                        faces[k * d + d - j - 1] = face_tmp[1 - j];
+            /* Connect the new faces to each other, and to the faces on the other side of the horizon */
+            link_cone(d, faces, fnbr, newf, n_newfaces, i, hz_face, hz_slot, ws->keys);
 
-                    /* Modify the plane coefficients of the properly oriented faces */
-                    for (j = 0; j < d; j++)
-                        cf[k * d + j] = -cf[k * d + j];
-                    df[k] = -df[k];
-                    for (l = 0; l < d; l++)
-                        for (j = 0; j < d + 1; j++)
-                            A[l * (d + 1) + j] = points[(faces[k * d + l]) * (d + 1) + j];
-                    for (; l < d + 1; l++)
-                        for (j = 0; j < d + 1; j++)
-                            A[l * (d + 1) + j] = points[pp[index] * (d + 1) + j];
-#ifndef NDEBUG
-                    /* Check */
-                    if (d == 3)
-                        detA = det_4x4(A);
-                    else
-                        detA = det_NxN((CH_FLOAT *)A, d + 1);
-                    /* If you hit this assertion error, then the face cannot be properly orientated and building the convex hull is likely impossible */
-                    if (detA <= 0.0)
-                    {
-                        throw std::runtime_error("face cannot be properly orientated");
-                    }
-#endif
-                }
-                ch_free(pp);
+            /* Compact the face slots, once fewer than half of them are in use */
+            if (nFaces < nSlots / 2)
+            {
+                nSlots = compact_faces(d, nSlots, faces, fnbr, pl, ld, ws->fremap);
+                nFree = 0;
             }
-            if (horizon_size1 > 0)
-                ch_free(horizon);
-            ch_free(f0);
-            ch_free(nonvisible_faces);
-            ch_free(visible);
-            ch_free(hVec);
-            ch_free(hVec_mem_face);
         }
-        if (ERROR)
+    }
+
+    /* Remove any remaining deleted faces from the output */
+    if (nSlots != nFaces)
+        compact_faces(d, nSlots, faces, fnbr, pl, ld, ws->fremap);
+
+    /* output; leaving out the faces through the point at infinity, if there is one */
+    visible = ws->visible;
+    for (i = 0, k = 0; i < nFaces; i++)
+    {
+        for (j = 0; j < d; j++)
+            if (faces[i * d + j] == top)
+                break;
+        if (j == d)
+            visible[k++] = i;
+    }
+    (*out_faces) = (int *)ch_malloc(size_t(MAX(k, 1) * d) * sizeof(int));
+    if (out_cf != NULL)
+        (*out_cf) = (CH_FLOAT *)ch_malloc(size_t(MAX(k, 1) * d) * sizeof(CH_FLOAT));
+    if (out_df != NULL)
+        (*out_df) = (CH_FLOAT *)ch_malloc(size_t(MAX(k, 1)) * sizeof(CH_FLOAT));
+    if ((*out_faces) == NULL || (out_cf != NULL && (*out_cf) == NULL) || (out_df != NULL && (*out_df) == NULL))
+        return CH_ERROR_MEMORY;
+    for (i = 0; i < k; i++)
+        memcpy((*out_faces) + i * d, faces + visible[i] * d, size_t(d) * sizeof(int));
+    (*nOut_faces) = k;
+    if (out_cf != NULL)
+    {
+        for (i = 0; i < k; i++)
+            for (j = 0; j < d; j++)
+                (*out_cf)[i * d + j] = pl[j * ld + visible[i]];
+    }
+    if (out_df != NULL)
+    {
+        for (i = 0; i < k; i++)
+            (*out_df)[i] = pl[d * ld + visible[i]];
+    }
+    return status;
+}
+
+/* Runs convhull_nd_build_ws() with a fresh workspace, which is freed however the build ends; as are the outputs, unless
+ * the hull was built (or the build was stopped) */
+template <int D>
+static ch_status convhull_nd_build_fixed(CH_FLOAT *const in_vertices, const int nVert, const int nd,
+                                         const convhull_3d_options *options, int **out_faces, CH_FLOAT **out_cf,
+                                         CH_FLOAT **out_df, int *nOut_faces)
+{
+    ch_nd_workspace ws;
+    ch_status status;
+
+    memset(&ws, 0, sizeof(ch_nd_workspace));
+    status = convhull_nd_build_ws<D>(in_vertices, nVert, nd, options, &ws, out_faces, out_cf, out_df, nOut_faces);
+    nd_ws_free(&ws);
+    return status;
+}
+
+ch_status convhull_nd_build_ex(CH_FLOAT *const in_vertices, const int nVert, const int d,
+                               const convhull_3d_options *options, int **out_faces, CH_FLOAT **out_cf,
+                               CH_FLOAT **out_df, int *nOut_faces)
+{
+    convhull_3d_options default_options;
+    ch_status status;
+
+    if (options == NULL)
+    {
+        convhull_3d_options_default(&default_options);
+        options = &default_options;
+    }
+    (*out_faces) = NULL;
+    (*nOut_faces) = 0;
+    if (out_cf != NULL)
+        (*out_cf) = NULL;
+    if (out_df != NULL)
+        (*out_df) = NULL;
+    if (d < 2 || d > CONVHULL_ND_MAX_DIMENSIONS)
+        return CH_ERROR_INVALID_ARGUMENT;
+
+    /* 2-D hulls are polygons, which are built directly. Otherwise, build with the engine that is specialised for this
+     * number of dimensions */
+    if (d == 2 && nVert > 2 && in_vertices != NULL)
+        status = convhull_2d_build(in_vertices, nVert, options, out_faces, out_cf, out_df, nOut_faces);
+    else
+    {
+        switch (d)
         {
-            break;
+            case 3:
+                status = convhull_nd_build_fixed<3>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
+            case 4:
+                status = convhull_nd_build_fixed<4>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
+            case 5:
+                status = convhull_nd_build_fixed<5>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
+            case 6:
+                status = convhull_nd_build_fixed<6>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
+            case 7:
+                status = convhull_nd_build_fixed<7>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
+            case 8:
+                status = convhull_nd_build_fixed<8>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
+            default:
+                status = convhull_nd_build_fixed<0>(in_vertices, nVert, d, options, out_faces, out_cf, out_df, nOut_faces);
+                break;
         }
     }
 
-    /* output */
-    if (ERROR)
+    /* The outputs are only kept if there is a hull to put in them */
+    if (status != CH_OK && status != CH_CANCELLED)
     {
+        ch_free((*out_faces));
         (*out_faces) = NULL;
-        if (out_cf != NULL)
-            (*out_cf) = NULL;
-        if (out_df != NULL)
-            (*out_df) = NULL;
         (*nOut_faces) = 0;
-    }
-    else
-    {
-        (*out_faces) = (int *)ch_malloc(size_t(nFaces * d) * sizeof(int));
-        memcpy((*out_faces), faces, size_t(nFaces * d) * sizeof(int));
-        (*nOut_faces) = nFaces;
         if (out_cf != NULL)
         {
-            (*out_cf) = (CH_FLOAT *)ch_malloc(size_t(nFaces * d) * sizeof(CH_FLOAT));
-            memcpy((*out_cf), cf, size_t(nFaces * d) * sizeof(CH_FLOAT));
+            ch_free((*out_cf));
+            (*out_cf) = NULL;
         }
         if (out_df != NULL)
         {
-            (*out_df) = (CH_FLOAT *)ch_malloc(size_t(nFaces) * sizeof(CH_FLOAT));
-            memcpy((*out_df), df, size_t(nFaces) * sizeof(CH_FLOAT));
-        }
-    }
-
-    /* clean-up */
-    ch_free(visible_ind);
-    ch_free(points_cf);
-    ch_free(points_s);
-    ch_free(face_s);
-    ch_free(gVec);
-    ch_free(meanp);
-    ch_free(absdist);
-    ch_free(reldist);
-    ch_free(desReldist);
-    ch_free(ind);
-    ch_free(span);
-    ch_free(points);
-    ch_free(faces);
-    ch_free(aVec);
-    ch_free(cf);
-    ch_free(cfi);
-    ch_free(df);
-    ch_free(p_s);
-    ch_free(fVec);
-    ch_free(bVec);
-    ch_free(A);
+            ch_free((*out_df));
+            (*out_df) = NULL;
+        }
+    }
+    return status;
 }
 
-void delaunay_nd_mesh(const float *points, const int nPoints, const int nd, int **Mesh, int *nMesh)
+void convhull_nd_build_opt(CH_FLOAT *const in_vertices, const int nVert, const int d,
+                           const convhull_3d_options *options, int **out_faces, CH_FLOAT **out_cf, CH_FLOAT **out_df,
+                           int *nOut_faces)
 {
-    int i, j, k, nHullFaces, maxW_idx, nVisible;
-    int *hullfaces;
-    CH_FLOAT w0, w_optimal, w_optimal2;
-    CH_FLOAT *projpoints, *cf, *df, *p0, *p, *visible;
+    convhull_3d_options nd_options;
+    ch_status status;
 
-    /* Project the N-dimensional points onto a N+1-dimensional paraboloid */
-    projpoints = (CH_FLOAT *)ch_malloc(size_t(nPoints * (nd + 1)) * sizeof(CH_FLOAT));
-    for (i = 0; i < nPoints; i++)
-    {
-        projpoints[i * (nd + 1) + nd] = 0.0;
-        for (j = 0; j < nd; j++)
-        {
-            projpoints[i * (nd + 1) + j] =
-              (CH_FLOAT)points[i * nd + j] + 0.0000001 * (CH_FLOAT)rand() / (CH_FLOAT)RAND_MAX;
-            projpoints[i * (nd + 1) + nd] +=
-              (projpoints[i * (nd + 1) + j] * projpoints[i * (nd + 1) + j]); /* w vector */
-        }
-    }
+    /* The face budget, time budget and cancellation flag are left out, as this builder cannot report them */
+    if (options == NULL)
+        convhull_3d_options_default(&nd_options);
+    else
+        nd_options = (*options);
+    nd_options.max_faces = 0;
+    nd_options.time_budget = 0.0;
+    nd_options.cancel = NULL;
+    status = convhull_nd_build_ex(in_vertices, nVert, d, &nd_options, out_faces, out_cf, out_df, nOut_faces);
+
+    /* If you hit this assertion error, then the input vertices do not span all 'd' dimensions. Therefore the convex hull cannot be built.
+     * In these cases, reduce the dimensionality of the points and call convhull_nd_build() instead with d<3 */
+    if (status == CH_ERROR_DEGENERATE)
+        CH_THROW("input vertices do not span all 'd' dimensions");
+    /* If you hit this assertion error, then the face cannot be properly orientated and building the convex hull is likely impossible */
+    if (status == CH_ERROR_NUMERIC)
+        CH_THROW("face cannot be properly orientated");
+    /* If you hit this assertion error, then 'd' is out of range */
+    if (status == CH_ERROR_INVALID_ARGUMENT)
+        CH_THROW("'d' must be from 2 to CONVHULL_ND_MAX_DIMENSIONS");
+}
 
-    /* The N-dimensional delaunay triangulation requires first computing the convex hull of this N+1-dimensional paraboloid */
-    hullfaces = NULL;
-    cf = df = NULL;
-    convhull_nd_build(projpoints, nPoints, nd + 1, &hullfaces, &cf, &df, &nHullFaces);
+/* The 2-D and 3-D Delaunay engines below keep the triangles (tetrahedra) in the same layout as the faces of the N-D
+ * hull: simplex s has the vertices simp[s*(D+1)+k], and nbr[s*(D+1)+k] is the simplex that shares the facet opposite
+ * vertex k. The outside of the convex hull is covered by 'ghost' simplices, one per hull facet, which join that facet to
+ * a vertex at infinity (with index nPoints); so that every facet has a simplex on both sides. All simplices are
+ * positively oriented (see orient2d()/orient3d()), where a ghost counts as positive if it becomes so when its vertex
+ * at infinity is replaced by a point outside of its hull facet. Deleted simplices have simp[s*(D+1)] == -1 */
 
-    /* Find the coordinates of the point with the maximum (N+1 dimension) coordinate (i.e. the w vector) */
-#ifdef CONVHULL_3D_USE_CBLAS
-    if (sizeof(CH_FLOAT) == sizeof(double))
-        maxW_idx = (int)cblas_idamax(nPoints, (double *)&projpoints[nd], nd + 1);
+/* Orientation of simplex s (its vertices; D+1 x 1), with vertex k replaced by the point p */
+template <int D>
+static int delaunay_orient(const double *x, const int *s, const int k, const double *p)
+{
+    const double *q[D + 1];
+    for (int i = 0; i < D + 1; i++)
+        q[i] = i == k ? p : &x[s[i] * D];
+    if constexpr (D == 2)
+        return orient2d(q[0], q[1], q[2]);
     else
-        maxW_idx = (int)cblas_isamax(nPoints, (float *)&projpoints[nd], nd + 1);
-#else
-    double maxVal;
-    maxVal = -2.23e13;
-    maxW_idx = -1;
-    for (i = 0; i < nPoints; i++)
+        return orient3d(q[0], q[1], q[2], q[3]);
+}
+
+/* Slot of vertex v in simplex s (its vertices; D+1 x 1), or -1 if s does not have it */
+template <int D>
+static int delaunay_slot(const int *s, const int v)
+{
+    for (int i = 0; i < D + 1; i++)
+        if (s[i] == v)
+            return i;
+    return -1;
+}
+
+/* Whether the point p is in conflict with simplex s, i.e. lies inside its circumcircle (circumsphere). A ghost is in
+ * conflict with the points outside of its hull facet, and with those on the facet's line (plane) that are in conflict
+ * with the simplex on the other side of it */
+template <int D>
+static int delaunay_conflict(const double *x, const int *simp, const int *nbr, const int s, const int inf,
+                             const double *p)
+{
+    const int *v = &simp[s * (D + 1)];
+    int g, o;
+
+    g = delaunay_slot<D>(v, inf);
+    if (g >= 0)
     {
-        if (projpoints[i * (nd + 1) + nd] > maxVal)
-        {
-            maxVal = projpoints[size_t(i * (nd + 1) + nd)];
-            maxW_idx = i;
-        }
+        o = delaunay_orient<D>(x, v, g, p);
+        if (o != 0)
+            return o > 0;
+        v = &simp[nbr[s * (D + 1) + g] * (D + 1)];
     }
-    assert(maxW_idx != -1);
-#endif
-    w0 = projpoints[maxW_idx * (nd + 1) + nd];
-    p0 = (CH_FLOAT *)ch_malloc(size_t(nd) * sizeof(CH_FLOAT));
-    for (j = 0; j < nd; j++)
-        p0[j] = projpoints[maxW_idx * (nd + 1) + j];
-
-    /* Find the point where the plane tangent to the point (p0,w0) on the paraboloid crosses the w axis.
-     * This is the point that can see the entire lower hull. */
-    w_optimal = 0.0;
-    for (j = 0; j < nd; j++)
-        w_optimal += (2.0 * pow(p0[j], 2.0));
-    w_optimal = w0 - w_optimal;
-
-    /* Subtract 1000 times the absolute value of w_optimal to ensure that the point where the tangent plane
-     * crosses the w axis will see all points on the lower hull. This avoids numerical roundoff errors. */
-    w_optimal2 = w_optimal - 1000.0 * fabs(w_optimal);
-
-    /* Set the point where the tangent plane crosses the w axis */
-    p = (CH_FLOAT *)ch_calloc(size_t(nd + 1), sizeof(CH_FLOAT));
-    p[nd] = w_optimal2;
-
-    /* Find all faces that are visible from this point */
-    visible = (CH_FLOAT *)ch_malloc(size_t(nHullFaces) * sizeof(CH_FLOAT));
-#ifdef CONVHULL_3D_USE_CBLAS
-    if (sizeof(CH_FLOAT) == sizeof(double))
-    {
-        cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, nHullFaces, 1, nd + 1, 1.0, (double *)cf, nd + 1,
-                    (double *)p, 1, 0.0, (double *)visible, 1);
+    if constexpr (D == 2)
+        return incircle(&x[v[0] * 2], &x[v[1] * 2], &x[v[2] * 2], p) > 0;
+    else
+        return insphere(&x[v[0] * 3], &x[v[1] * 3], &x[v[2] * 3], &x[v[3] * 3], p) > 0;
+}
+
+/* Whether point v is affinely independent of the first k (1 <= k <= D) points of 'simplex' */
+template <int D>
+static int delaunay_independent(const double *x, const int *simplex, const int k, const int v)
+{
+    const double *a = &x[simplex[0] * D], *q = &x[v * D], *b, *c;
+    int j;
+
+    if (k == 1)
+    {
+        for (j = 0; j < D; j++)
+            if (q[j] != a[j])
+                return 1;
+        return 0;
     }
+    b = &x[simplex[1] * D];
+    if constexpr (D == 2)
+        return orient2d(a, b, q) != 0;
     else
     {
-        cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, nHullFaces, 1, nd + 1, 1.0f, (float *)cf, nd + 1,
-                    (float *)p, 1, 0.0f, (float *)visible, 1);
+        if (k == 2) /* not collinear, if any of the three projections onto the coordinate planes are not */
+            return orient2d_exact(a[0], a[1], b[0], b[1], q[0], q[1]) != 0 ||
+                   orient2d_exact(a[1], a[2], b[1], b[2], q[1], q[2]) != 0 ||
+                   orient2d_exact(a[2], a[0], b[2], b[0], q[2], q[0]) != 0;
+        c = &x[simplex[2] * D];
+        return orient3d(a, b, c, q) != 0;
     }
-#else
-    for (i = 0; i < nHullFaces; i++)
+}
+
+/* The working memory of the Delaunay engines, which is all released by delaunay_ws_free() however the build ends */
+typedef struct _ch_delaunay_workspace
+{
+    double *x; /* the points, in double precision; flat: nPoints x D */
+    int *order; /* the insertion order; nPoints x 1 */
+    key_w_idx *keys; /* scratch space for insertion_order(); 2*nPoints x 1 */
+    int *simp, *nbr; /* vertices and neighbours of each simplex; flat: maxSimp x (D+1) */
+    int *mark, *freelist; /* cavity marks of each simplex, and the free simplex slots; maxSimp x 1 */
+    int *cav; /* simplices of the cavity; maxCav x 1 */
+    int *bnd; /* (simplex, slot) of each boundary facet of the cavity; flat: maxBnd x 2 */
+    int *lnext, *lkey, *llink; /* links between the new simplices; maxBnd*D x 1 */
+    int *vhead; /* first link listed under each vertex; (nPoints+1) x 1 */
+} ch_delaunay_workspace;
+
+static void delaunay_ws_free(ch_delaunay_workspace *ws)
+{
+    ch_free(ws->x);
+    ch_free(ws->order);
+    ch_free(ws->keys);
+    ch_free(ws->simp);
+    ch_free(ws->nbr);
+    ch_free(ws->mark);
+    ch_free(ws->freelist);
+    ch_free(ws->cav);
+    ch_free(ws->bnd);
+    ch_free(ws->lnext);
+    ch_free(ws->lkey);
+    ch_free(ws->llink);
+    ch_free(ws->vhead);
+    memset(ws, 0, sizeof(ch_delaunay_workspace));
+}
+
+/* Delaunay triangulation for D = 2 or 3, built directly by incremental (Bowyer-Watson) insertion: the points are taken
+ * up in BRIO order; each is located by walking from the last new simplex towards it, and then the simplices whose
+ * circumcircles (circumspheres) contain it are removed, and the hole is filled by joining its boundary to the point.
+ * The predicates are exact, so no noise is added: ties between cocircular (cospherical) points, which are common in
+ * gridded inputs, are broken by only removing the simplices whose circumcircles strictly contain the new point. Points
+ * that coincide with an earlier one are left out. All of its working memory is taken from 'ws' (see
+ * delaunay_build_fixed()); it returns CH_ERROR_DEGENERATE if the points do not span all D dimensions, or
+ * CH_ERROR_MEMORY if the memory cannot be had */
+template <int D>
+static ch_status delaunay_build_ws(const float *points, const int nPoints, ch_delaunay_workspace *ws, int **Mesh,
+                                   int *nMesh)
+{
+    const int n1 = D + 1;
+    const int inf = nPoints; /* the vertex at infinity */
+    int i, j, k, l, s, t, nb, p, u, v, e, pe, step, stamp, nSimp, maxSimp, nFree, nCav, maxCav, nBnd, maxBnd, nLinks,
+      last, nOut;
+    int *simp, *nbr, *mark, *freelist, *cav, *bnd, *order, *vhead, *lnext, *lkey, *llink;
+    int simplex[D + 1], r[D - 1] = { 0 };
+    double *x;
+
+    if (nPoints < D + 1)
+        return CH_ERROR_DEGENERATE;
+    x = ws->x = (double *)ch_malloc(size_t(nPoints) * D * sizeof(double));
+    order = ws->order = (int *)ch_malloc(size_t(nPoints) * sizeof(int));
+    ws->keys = (key_w_idx *)ch_malloc(size_t(2 * nPoints) * sizeof(key_w_idx));
+    if (x == NULL || order == NULL || ws->keys == NULL)
+        return CH_ERROR_MEMORY;
+    for (i = 0; i < nPoints * D; i++)
+        x[i] = (double)points[i];
+
+    /* Insertion order, and the first simplex: the first points in that order that span all D dimensions */
+    insertion_order(x, D, nPoints, D, 1, 0, 1, ws->keys, order);
+    for (i = 1, k = 1, simplex[0] = order[0]; i < nPoints && k < n1; i++)
+        if (delaunay_independent<D>(x, simplex, k, order[i]))
+            simplex[k++] = order[i];
+    if (k < n1)
+        return CH_ERROR_DEGENERATE;
+    if (delaunay_orient<D>(x, simplex, 0, &x[simplex[0] * D]) < 0)
     {
-        visible[i] = 0.0;
-        for (j = 0; j < nd + 1; j++)
-            visible[i] += cf[i * (nd + 1) + j] * p[j];
+        k = simplex[0];
+        simplex[0] = simplex[1];
+        simplex[1] = k;
     }
-#endif
-    nVisible = 0;
-    for (j = 0; j < nHullFaces; j++)
+
+    /* The simplex, and a ghost on each of its facets (with two vertices swapped, so that it is positively oriented) */
+    maxSimp = (D == 2 ? 2 : 7) * nPoints + 16;
+    simp = ws->simp = (int *)ch_malloc(size_t(maxSimp) * n1 * sizeof(int));
+    nbr = ws->nbr = (int *)ch_malloc(size_t(maxSimp) * n1 * sizeof(int));
+    mark = ws->mark = (int *)ch_calloc(size_t(maxSimp), sizeof(int));
+    freelist = ws->freelist = (int *)ch_malloc(size_t(maxSimp) * sizeof(int));
+    if (simp == NULL || nbr == NULL || mark == NULL || freelist == NULL)
+        return CH_ERROR_MEMORY;
+    for (k = 0; k < n1; k++)
+        simp[k] = simplex[k];
+    for (s = 1; s < n1 + 1; s++)
     {
-        visible[j] += df[j];
-        if (visible[j] > 0.0)
-            nVisible++;
+        for (k = 0; k < n1; k++)
+            simp[s * n1 + k] = simplex[k];
+        simp[s * n1 + s - 1] = inf;
+        simp[s * n1 + s % n1] = simplex[(s + 1) % n1];
+        simp[s * n1 + (s + 1) % n1] = simplex[s % n1];
     }
+    nSimp = n1 + 1;
+    for (s = 0; s < nSimp; s++) /* each pair of simplices shares exactly one facet */
+        for (t = s + 1; t < nSimp; t++)
+        {
+            for (k = 0; k < n1; k++) /* the vertex of s that t does not have, and vice versa */
+                if (delaunay_slot<D>(&simp[t * n1], simp[s * n1 + k]) < 0)
+                    break;
+            for (l = 0; l < n1; l++)
+                if (delaunay_slot<D>(&simp[s * n1], simp[t * n1 + l]) < 0)
+                    break;
+            nbr[s * n1 + k] = t;
+            nbr[t * n1 + l] = s;
+        }
 
-    /* Output */
-    (*nMesh) = nVisible;
-    if (nVisible > 0)
+    /* Insert the remaining points */
+    maxCav = maxBnd = 64;
+    cav = ws->cav = (int *)ch_malloc(size_t(maxCav) * sizeof(int));
+    bnd = ws->bnd = (int *)ch_malloc(size_t(maxBnd) * 2 * sizeof(int));
+    lnext = ws->lnext = (int *)ch_malloc(size_t(maxBnd) * D * sizeof(int));
+    lkey = ws->lkey = (int *)ch_malloc(size_t(maxBnd) * D * sizeof(int));
+    llink = ws->llink = (int *)ch_malloc(size_t(maxBnd) * D * sizeof(int));
+    vhead = ws->vhead = (int *)ch_malloc(size_t(nPoints + 1) * sizeof(int));
+    if (cav == NULL || bnd == NULL || lnext == NULL || lkey == NULL || llink == NULL || vhead == NULL)
+        return CH_ERROR_MEMORY;
+    for (i = 0; i < nPoints + 1; i++)
+        vhead[i] = -1;
+    nFree = 0;
+    last = 0;
+    step = 0;
+    stamp = 0;
+    for (i = 0; i < nPoints; i++)
     {
-        (*Mesh) = (int *)ch_malloc(size_t(nVisible * (nd + 1)) * sizeof(int));
-        for (i = 0, j = 0; i < nHullFaces; i++)
+        p = order[i];
+        if (delaunay_slot<D>(simplex, p) >= 0)
+            continue;
+
+        /* Walk from the last new simplex towards p, through any facet that p is beyond, starting from a different
+         * facet each time; which ends at the simplex that contains p, or at a ghost whose hull facet p is beyond */
+        t = last;
+        pe = -1;
+        while (delaunay_slot<D>(&simp[t * n1], inf) < 0)
+        {
+            for (j = 0, step++; j < n1; j++)
+            {
+                k = (step + j) % n1;
+                nb = nbr[t * n1 + k];
+                if (nb != pe && delaunay_orient<D>(x, &simp[t * n1], k, &x[p * D]) < 0)
+                    break;
+            }
+            if (j == n1)
+                break;
+            pe = t;
+            t = nb;
+        }
+        if (!delaunay_conflict<D>(x, simp, nbr, t, inf, &x[p * D]))
+            continue; /* p coincides with a vertex of t */
+
+        /* The cavity: the simplices in conflict with p that are connected to t, and the facets on its boundary */
+        stamp++;
+        mark[t] = 2 * stamp;
+        cav[0] = t;
+        nCav = 1;
+        nBnd = 0;
+        for (j = 0; j < nCav; j++)
+        {
+            t = cav[j];
+            for (k = 0; k < n1; k++)
+            {
+                nb = nbr[t * n1 + k];
+                if (mark[nb] == 2 * stamp)
+                    continue;
+                if (mark[nb] != 2 * stamp + 1 && delaunay_conflict<D>(x, simp, nbr, nb, inf, &x[p * D]))
+                {
+                    mark[nb] = 2 * stamp;
+                    if (nCav == maxCav)
+                    {
+                        if (!ch_grow(&ws->cav, size_t(2 * maxCav)))
+                            return CH_ERROR_MEMORY;
+                        cav = ws->cav;
+                        maxCav *= 2;
+                    }
+                    cav[nCav++] = nb;
+                }
+                else
+                {
+                    mark[nb] = 2 * stamp + 1;
+                    if (nBnd == maxBnd)
+                    {
+                        if (!ch_grow(&ws->bnd, size_t(2 * maxBnd) * 2) || !ch_grow(&ws->lnext, size_t(2 * maxBnd) * D) ||
+                            !ch_grow(&ws->lkey, size_t(2 * maxBnd) * D) || !ch_grow(&ws->llink, size_t(2 * maxBnd) * D))
+                            return CH_ERROR_MEMORY;
+                        bnd = ws->bnd;
+                        lnext = ws->lnext;
+                        lkey = ws->lkey;
+                        llink = ws->llink;
+                        maxBnd *= 2;
+                    }
+                    bnd[nBnd * 2] = t;
+                    bnd[nBnd * 2 + 1] = k;
+                    nBnd++;
+                }
+            }
+        }
+
+        /* Join each boundary facet to p. The new simplices take the slots freed by earlier insertions, so that the
+         * cavity is left intact until they have all been made */
+        if (nSimp + nBnd > maxSimp)
+        {
+            maxSimp = MAX(2 * maxSimp, nSimp + nBnd);
+            if (!ch_grow(&ws->simp, size_t(maxSimp) * n1) || !ch_grow(&ws->nbr, size_t(maxSimp) * n1) ||
+                !ch_grow(&ws->mark, size_t(maxSimp)) || !ch_grow(&ws->freelist, size_t(maxSimp)))
+                return CH_ERROR_MEMORY;
+            simp = ws->simp;
+            nbr = ws->nbr;
+            mark = ws->mark;
+            freelist = ws->freelist;
+        }
+        for (j = 0, nLinks = 0; j < nBnd; j++)
         {
-            if (visible[i] > 0.0)
+            t = bnd[j * 2];
+            k = bnd[j * 2 + 1];
+            nb = nbr[t * n1 + k];
+            s = nFree > 0 ? freelist[--nFree] : nSimp++;
+            mark[s] = 0;
+            for (l = 0; l < n1; l++)
+                simp[s * n1 + l] = simp[t * n1 + l];
+            simp[s * n1 + k] = p;
+            nbr[s * n1 + k] = nb;
+            for (l = 0; nbr[nb * n1 + l] != t; l++)
+                ;
+            nbr[nb * n1 + l] = s;
+            if (delaunay_slot<D>(&simp[s * n1], inf) < 0)
+                last = s;
+
+            /* The other facets of s contain p, and are each shared with one other new simplex; which is found through
+             * the (D-1) vertices that they have besides p, listed under the lowest of them */
+            for (l = 0; l < n1; l++)
             {
-                for (k = 0; k < nd + 1; k++)
-                    (*Mesh)[j * (nd + 1) + k] = hullfaces[i * (nd + 1) + k];
-                j++;
+                if (l == k)
+                    continue;
+                for (e = 0, u = 0; e < n1; e++)
+                    if (e != k && e != l)
+                        r[u++] = simp[s * n1 + e];
+                u = D == 2 ? r[0] : MIN(r[0], r[D - 2]);
+                v = D == 2 ? -1 : MAX(r[0], r[D - 2]);
+                for (e = vhead[u], pe = -1; e != -1 && lkey[e] != v; pe = e, e = lnext[e])
+                    ;
+                if (e == -1)
+                {
+                    lkey[nLinks] = v;
+                    llink[nLinks] = s * n1 + l;
+                    lnext[nLinks] = vhead[u];
+                    vhead[u] = nLinks++;
+                }
+                else
+                {
+                    nbr[s * n1 + l] = llink[e] / n1;
+                    nbr[llink[e]] = s;
+                    if (pe == -1)
+                        vhead[u] = lnext[e];
+                    else
+                        lnext[pe] = lnext[e];
+                }
             }
         }
-        assert(j == nVisible);
+
+        /* Delete the cavity */
+        for (j = 0; j < nCav; j++)
+        {
+            simp[cav[j] * n1] = -1;
+            freelist[nFree++] = cav[j];
+        }
+    }
+
+    /* Output the finite simplices; with the first two vertices swapped, for the same orientation as the lifted hull
+     * gives them */
+    for (s = 0, nOut = 0; s < nSimp; s++)
+        if (simp[s * n1] != -1 && delaunay_slot<D>(&simp[s * n1], inf) < 0)
+            nOut++;
+    (*Mesh) = (int *)ch_malloc(size_t(MAX(nOut, 1)) * n1 * sizeof(int));
+    if ((*Mesh) == NULL)
+        return CH_ERROR_MEMORY;
+    for (s = 0, nOut = 0; s < nSimp; s++)
+        if (simp[s * n1] != -1 && delaunay_slot<D>(&simp[s * n1], inf) < 0)
+        {
+            for (k = 0; k < n1; k++)
+                (*Mesh)[nOut * n1 + k] = simp[s * n1 + (k < 2 ? 1 - k : k)];
+            nOut++;
+        }
+    (*nMesh) = nOut;
+    return CH_OK;
+}
+
+/* Runs delaunay_build_ws() with a fresh workspace, which is freed however the build ends. The mesh is left empty if
+ * the points do not span all D dimensions (which throws, if exceptions are enabled), or if the memory cannot be had */
+template <int D>
+static void delaunay_build_fixed(const float *points, const int nPoints, int **Mesh, int *nMesh)
+{
+    ch_delaunay_workspace ws;
+    ch_status status;
+
+    (*Mesh) = NULL;
+    (*nMesh) = 0;
+    memset(&ws, 0, sizeof(ch_delaunay_workspace));
+    status = delaunay_build_ws<D>(points, nPoints, &ws, Mesh, nMesh);
+    delaunay_ws_free(&ws);
+    if (status == CH_OK)
+        return;
+    ch_free((*Mesh));
+    (*Mesh) = NULL;
+    (*nMesh) = 0;
+    if (status == CH_ERROR_DEGENERATE)
+        CH_THROW("input points do not span all 'nd' dimensions");
+}
+
+void delaunay_nd_mesh(const float *points, const int nPoints, const int nd, int **Mesh, int *nMesh)
+{
+    int i, j, nHullFaces;
+    int *hullfaces;
+    CH_FLOAT *projpoints;
+    convhull_3d_options options;
+
+    /* 2-D and 3-D meshes are built directly */
+    if (nd == 2)
+    {
+        delaunay_build_fixed<2>(points, nPoints, Mesh, nMesh);
+        return;
+    }
+    if (nd == 3)
+    {
+        delaunay_build_fixed<3>(points, nPoints, Mesh, nMesh);
+        return;
+    }
+
+    /* Otherwise, project the N-dimensional points onto a N+1-dimensional paraboloid (the mesh is left empty if the
+     * memory for them cannot be had) */
+    (*Mesh) = NULL;
+    (*nMesh) = 0;
+    projpoints = (CH_FLOAT *)ch_malloc(size_t(MAX(nPoints, 1)) * size_t(nd + 1) * sizeof(CH_FLOAT));
+    if (projpoints == NULL)
+        return;
+    for (i = 0; i < nPoints; i++)
+    {
+        projpoints[i * (nd + 1) + nd] = 0.0;
+        for (j = 0; j < nd; j++)
+        {
+            projpoints[i * (nd + 1) + j] =
+              (CH_FLOAT)points[i * nd + j] + 0.0000001 * ch_noise(0, uint64_t(i) * uint64_t(nd) + uint64_t(j));
+            projpoints[i * (nd + 1) + nd] +=
+              (projpoints[i * (nd + 1) + j] * projpoints[i * (nd + 1) + j]); /* w vector */
+        }
     }
 
+    /* The N-dimensional delaunay triangulation is the lower hull of this N+1-dimensional paraboloid (i.e. the faces
+     * that can be seen from below it), which is all that is built */
+    hullfaces = NULL;
+    convhull_3d_options_default(&options);
+    options.lower_hull = 1;
+    options.insertion_order = CH_ORDER_BRIO;
+    convhull_nd_build_opt(projpoints, nPoints, nd + 1, &options, &hullfaces, NULL, NULL, &nHullFaces);
+
+    /* Output */
+    (*nMesh) = nHullFaces;
+    if (nHullFaces > 0)
+        (*Mesh) = hullfaces;
+    else
+        ch_free(hullfaces);
+
     /* clean up */
     ch_free(projpoints);
-    ch_free(hullfaces);
-    ch_free(cf);
-    ch_free(df);
-    ch_free(p0);
-    ch_free(p);
-    ch_free(visible);
 }
 
 //#endif /* CONVHULL_3D_ENABLE */
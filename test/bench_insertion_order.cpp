@@ -0,0 +1,164 @@
+/*
+ Copyright (c) 2017-2021 Leo McCormack
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/* Benchmarks the insertion orders (see ch_insertion_order) of convhull_3d_build_ctx() and convhull_nd_build_opt(), on
+ * the larger scanned meshes in 'obj_files', and on points on the surface of a sphere (where every point is a vertex of
+ * the hull, and the distance order has nothing to go on). Build with e.g.:
+ *   g++ -std=c++17 -O2 -I.. bench_insertion_order.cpp -o bench_insertion_order
+ * and run from this folder */
+
+#ifdef _MSC_VER
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#define CONVHULL_3D_ENABLE
+#include "convhull_3d.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265359
+#endif
+
+#define N_REPEATS 3
+#define N_ORDERS 3
+static const int orders[N_ORDERS] = { CH_ORDER_DISTANCE, CH_ORDER_MORTON, CH_ORDER_BRIO };
+static const char* order_names[N_ORDERS] = { "distance", "morton", "brio" };
+
+#define N_OBJECT_FILES 5
+static const char* obj_test_files[N_OBJECT_FILES] = { "roi", "minicooper", "symphysis", "venusm", "trumpet" };
+
+/* best of N_REPEATS, in milliseconds */
+static double time_3d(convhull_3d_context* ctx, ch_vertex* vertices, int nVert, int order, int* nFaces)
+{
+    convhull_3d_options options;
+    int* faces;
+    double best = 1e30;
+    convhull_3d_options_default(&options);
+    options.insertion_order = order;
+    for (int r = 0; r < N_REPEATS; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        if (convhull_3d_build_ctx(ctx, vertices, nVert, &options, &faces, nFaces) != CH_OK)
+            *nFaces = -1;
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - t0;
+        best = MIN(best, ms.count());
+    }
+    return best;
+}
+
+static double time_nd(CH_FLOAT* points, int nPoints, int d, int order, int* nFaces)
+{
+    convhull_3d_options options;
+    int* faces = NULL;
+    double best = 1e30;
+    convhull_3d_options_default(&options);
+    options.insertion_order = order;
+    for (int r = 0; r < N_REPEATS; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        convhull_nd_build_opt(points, nPoints, d, &options, &faces, NULL, NULL, nFaces);
+        std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - t0;
+        best = MIN(best, ms.count());
+        free(faces);
+    }
+    return best;
+}
+
+static void run(const char* name, convhull_3d_context* ctx, ch_vertex* vertices, int nVert, int nd_points)
+{
+    int o, i, j, nFaces;
+    CH_FLOAT* points;
+
+    printf("%-14s %8d points |", name, nVert);
+    for (o = 0; o < N_ORDERS; o++) {
+        double ms = time_3d(ctx, vertices, nVert, orders[o], &nFaces);
+        printf(" %9.2f ms (%6d)", ms, nFaces);
+    }
+
+    /* the N-D builder is quadratic in the number of faces, so it only gets the first nd_points points */
+    nd_points = MIN(nd_points, nVert);
+    points = (CH_FLOAT*)malloc(nd_points*3*sizeof(CH_FLOAT));
+    for (i = 0; i < nd_points; i++)
+        for (j = 0; j < 3; j++)
+            points[i*3+j] = vertices[i][j];
+    printf(" | nd %6d:", nd_points);
+    for (o = 0; o < N_ORDERS; o++) {
+        double ms = time_nd(points, nd_points, 3, orders[o], &nFaces);
+        printf(" %9.2f ms (%5d)", ms, nFaces);
+    }
+    printf("\n");
+    free(points);
+}
+
+int main(void)
+{
+    int i, n, nVert, o;
+    ch_vertex* vertices;
+    char path[256];
+    convhull_3d_context* ctx;
+
+    printf("***************************************\n");
+    printf("* convhull_3d insertion order benchmark *\n");
+    printf("***************************************\n\n");
+    printf("%-14s %15s |", "input", "");
+    for (o = 0; o < N_ORDERS; o++)
+        printf(" %21s", order_names[o]);
+    printf(" | %10s", "");
+    for (o = 0; o < N_ORDERS; o++)
+        printf(" %21s", order_names[o]);
+    printf("\n");
+
+    ctx = convhull_3d_context_create();
+
+    /* scanned meshes */
+    for (i = 0; i < N_OBJECT_FILES; i++) {
+        snprintf(path, sizeof(path), "obj_files/%s", obj_test_files[i]);
+        vertices = NULL;
+        extractVerticesFromObjFile(path, &vertices, &nVert);
+        if (vertices == NULL) {
+            printf("%-14s could not be read (run from the 'test' folder)\n", obj_test_files[i]);
+            continue;
+        }
+        run(obj_test_files[i], ctx, vertices, nVert, 20000);
+        free(vertices);
+    }
+
+    /* points on the surface of a sphere, from a deterministic spiral, shuffled */
+    for (n = 10000; n <= 160000; n *= 4) {
+        vertices = (ch_vertex*)malloc(n*sizeof(ch_vertex));
+        for (i = 0; i < n; i++) {
+            int k = (int)(((uint64_t)i * 2654435761u) % (uint64_t)n); /* a permutation of 0..n-1, as 2654435761 is prime */
+            double z = 1.0 - (2.0*k + 1.0)/n;
+            double r = sqrt(1.0 - z*z);
+            double azi = k * M_PI * (3.0 - sqrt(5.0));
+            vertices[i][0] = r*cos(azi);
+            vertices[i][1] = r*sin(azi);
+            vertices[i][2] = z;
+        }
+        snprintf(path, sizeof(path), "sphere_%d", n);
+        run(path, ctx, vertices, n, 5000);
+        free(vertices);
+    }
+
+    convhull_3d_context_destroy(ctx);
+    return 0;
+}
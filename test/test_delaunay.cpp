@@ -0,0 +1,237 @@
+/*
+ Copyright (c) 2017-2021 Leo McCormack
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/* Checks the meshes of delaunay_nd_mesh() for 2-D and 3-D points (random, and on grids, where many points are
+ * cocircular/cospherical): no point may lie strictly inside the circumcircle (circumsphere) of any simplex, the
+ * simplices must all have the same orientation, and together they must cover the convex hull of the points exactly.
+ * Every allocation is also made to fail in turn, after which the mesh must be left empty. Build with e.g.:
+ *   g++ -std=c++17 -O2 -I.. test_delaunay.cpp -o test_delaunay
+ * The exit code is the number of failed checks */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+/* an allocator that fails on the g_fail'th call (counting from 0), if g_fail >= 0 */
+static long g_count = 0, g_fail = -1;
+static void* test_malloc(size_t n) { return g_count++ == g_fail ? NULL : malloc(n); }
+static void* test_calloc(size_t n, size_t m) { return g_count++ == g_fail ? NULL : calloc(n, m); }
+static void* test_realloc(void* p, size_t n) { return g_count++ == g_fail ? NULL : realloc(p, n); }
+#define ch_malloc test_malloc
+#define ch_calloc test_calloc
+#define ch_realloc test_realloc
+#define ch_free free
+#define CONVHULL_3D_ENABLE
+#include "convhull_3d.h"
+
+static int nFailed = 0;
+
+#define CHECK(cond, ...)                     \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAILED: " __VA_ARGS__);  \
+            printf("\n");                    \
+            nFailed++;                       \
+        }                                    \
+    } while (0)
+
+/* uniform in [0, 1), from a 64-bit LCG; so that the points are the same on every platform */
+static double rnd(uint64_t* s)
+{
+    *s = *s * 6364136223846793005ull + 1442695040888963407ull;
+    return (double)(*s >> 11) / 9007199254740992.0;
+}
+
+/* signed area (volume) of simplex s of the mesh */
+static double simplex_volume(const std::vector<float>& pts, int nd, const int* s)
+{
+    double a[3][3];
+    for (int i = 0; i < nd; i++)
+        for (int j = 0; j < nd; j++)
+            a[i][j] = (double)pts[s[i + 1] * nd + j] - (double)pts[s[0] * nd + j];
+    if (nd == 2)
+        return 0.5 * (a[0][0] * a[1][1] - a[0][1] * a[1][0]);
+    return (a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) - a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+            a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0])) / 6.0;
+}
+
+/* area (volume) of the convex hull of the points */
+static double hull_volume(const std::vector<float>& pts, int nd)
+{
+    int n = (int)pts.size() / nd, *faces, nFaces;
+    double vol = 0.0;
+    std::vector<CH_FLOAT> p(pts.begin(), pts.end());
+    convhull_nd_build(p.data(), n, nd, &faces, NULL, NULL, &nFaces);
+    for (int f = 0; f < nFaces; f++) {
+        const CH_FLOAT *a = &p[faces[f * nd] * nd], *b = &p[faces[f * nd + 1] * nd];
+        if (nd == 2)
+            vol += 0.5 * (a[0] * b[1] - a[1] * b[0]);
+        else {
+            const CH_FLOAT* c = &p[faces[f * nd + 2] * nd];
+            vol += (a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) +
+                    a[2] * (b[0] * c[1] - b[1] * c[0])) / 6.0;
+        }
+    }
+    free(faces);
+    return fabs(vol);
+}
+
+/* circumcentre of simplex s (its squared radius is returned), by solving 2(v_i - v_0).c = |v_i|^2 - |v_0|^2 */
+static double circumcentre(const std::vector<float>& pts, int nd, const int* s, double* c)
+{
+    double m[3][4], r2 = 0.0;
+    int i, j, k;
+    for (i = 0; i < nd; i++) {
+        m[i][nd] = 0.0;
+        for (j = 0; j < nd; j++) {
+            double p = pts[s[i + 1] * nd + j], q = pts[s[0] * nd + j];
+            m[i][j] = 2.0 * (p - q);
+            m[i][nd] += p * p - q * q;
+        }
+    }
+    for (k = 0; k < nd; k++) { /* Gaussian elimination, with partial pivoting */
+        int piv = k;
+        for (i = k + 1; i < nd; i++)
+            if (fabs(m[i][k]) > fabs(m[piv][k]))
+                piv = i;
+        for (j = 0; j <= nd; j++) {
+            double t = m[k][j];
+            m[k][j] = m[piv][j];
+            m[piv][j] = t;
+        }
+        for (i = k + 1; i < nd; i++) {
+            double f = m[i][k] / m[k][k];
+            for (j = k; j <= nd; j++)
+                m[i][j] -= f * m[k][j];
+        }
+    }
+    for (i = nd - 1; i >= 0; i--) {
+        c[i] = m[i][nd];
+        for (j = i + 1; j < nd; j++)
+            c[i] -= m[i][j] * c[j];
+        c[i] /= m[i][i];
+    }
+    for (j = 0; j < nd; j++)
+        r2 += (pts[s[0] * nd + j] - c[j]) * (pts[s[0] * nd + j] - c[j]);
+    return r2;
+}
+
+static void check_mesh(const std::vector<float>& pts, int nd, const char* name)
+{
+    int n = (int)pts.size() / nd, *mesh = NULL, nMesh = 0, m, p, j, sign = 0;
+    double vol = 0.0, worst = 0.0, c[3];
+
+    delaunay_nd_mesh(pts.data(), n, nd, &mesh, &nMesh);
+    CHECK(nMesh > 0 && mesh != NULL, "%s: no mesh", name);
+    for (m = 0; m < nMesh; m++) {
+        const int* s = &mesh[m * (nd + 1)];
+        double v = simplex_volume(pts, nd, s), r2;
+        CHECK(v != 0.0, "%s: simplex %d is flat", name, m);
+        if (v == 0.0)
+            continue;
+        if (sign == 0)
+            sign = v > 0 ? 1 : -1;
+        CHECK((v > 0 ? 1 : -1) == sign, "%s: simplex %d is inverted", name, m);
+        vol += fabs(v);
+
+        /* the empty circumcircle (circumsphere) property; points on it are allowed */
+        r2 = circumcentre(pts, nd, s, c);
+        for (p = 0; p < n; p++) {
+            double d2 = 0.0;
+            for (j = 0; j < nd; j++)
+                d2 += (pts[p * nd + j] - c[j]) * (pts[p * nd + j] - c[j]);
+            worst = MAX(worst, (r2 - d2) / r2);
+        }
+    }
+    CHECK(worst < 1e-9, "%s: a point is inside a circumsphere, by %g of its squared radius", name, worst);
+    double hv = hull_volume(pts, nd);
+    CHECK(fabs(vol - hv) <= 1e-9 * hv, "%s: the simplices cover %.12g, but the hull is %.12g", name, vol, hv);
+    free(mesh);
+}
+
+/* Makes every allocation of one mesh fail in turn; each time, the mesh must be left empty */
+static void check_out_of_memory(const std::vector<float>& pts, int nd, const char* name)
+{
+    int n = (int)pts.size() / nd, *mesh, nMesh, nFull = -1;
+    for (g_fail = 0;; g_fail++) {
+        g_count = 0;
+        mesh = NULL;
+        nMesh = -1;
+        delaunay_nd_mesh(pts.data(), n, nd, &mesh, &nMesh);
+        if (g_count <= g_fail) { /* no allocation failed */
+            nFull = nMesh;
+            free(mesh);
+            break;
+        }
+        CHECK(mesh == NULL && nMesh == 0, "%s: allocation %ld failed, but the mesh has %d simplices", name, g_fail, nMesh);
+        free(mesh);
+    }
+    g_fail = -1;
+    CHECK(nFull > 0, "%s: no mesh without allocation failures", name);
+}
+
+int main(void)
+{
+    std::vector<float> pts;
+    uint64_t seed = 1;
+    int i, j, k;
+
+    pts.resize(2000 * 2);
+    for (i = 0; i < (int)pts.size(); i++)
+        pts[i] = (float)rnd(&seed);
+    check_mesh(pts, 2, "2-D random");
+    check_out_of_memory(pts, 2, "2-D random");
+
+    pts.clear();
+    for (i = 0; i < 30; i++)
+        for (j = 0; j < 30; j++) {
+            pts.push_back((float)i);
+            pts.push_back((float)j);
+        }
+    check_mesh(pts, 2, "2-D grid");
+
+    pts.resize(600 * 3);
+    for (i = 0; i < (int)pts.size(); i++)
+        pts[i] = (float)rnd(&seed);
+    check_mesh(pts, 3, "3-D random");
+    check_out_of_memory(pts, 3, "3-D random");
+
+    pts.clear();
+    for (i = 0; i < 8; i++)
+        for (j = 0; j < 8; j++)
+            for (k = 0; k < 8; k++) {
+                pts.push_back((float)i);
+                pts.push_back((float)j);
+                pts.push_back((float)k);
+            }
+    check_mesh(pts, 3, "3-D grid");
+
+    pts.resize(300 * 4);
+    for (i = 0; i < (int)pts.size(); i++)
+        pts[i] = (float)rnd(&seed);
+    check_out_of_memory(pts, 4, "4-D random");
+
+    printf("%s (%d failed)\n", nFailed == 0 ? "PASSED" : "FAILED", nFailed);
+    return nFailed;
+}
@@ -0,0 +1,320 @@
+/*
+ Copyright (c) 2017-2021 Leo McCormack
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/* Checks that a convhull_3d_hull stays a valid hull of the points that are in it, as points are inserted, removed and
+ * moved: its faces must form a closed surface (every edge is shared by exactly two faces, running in opposite
+ * directions), only points that are in the hull may be vertices, and no such point may be above any face. Its volume
+ * must also match that of a hull built from scratch. Also checks that builds warm-started from the hull of the
+ * previous frame (convhull_3d_build_hint()) give the same faces as cold builds. Build with e.g.:
+ *   g++ -std=c++17 -O2 -I.. test_hull_updates.cpp -o test_hull_updates
+ * The exit code is the number of failed checks */
+
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <map>
+#include <utility>
+#include <algorithm>
+#define CONVHULL_3D_ENABLE
+#include "convhull_3d.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265359
+#endif
+
+static int nFailed = 0;
+
+#define CHECK(cond, ...)                     \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAILED: " __VA_ARGS__);  \
+            printf("\n");                    \
+            nFailed++;                       \
+        }                                    \
+    } while (0)
+
+/* uniform in [0, 1), from a 64-bit LCG; so that the points are the same on every platform */
+static double rnd(uint64_t* s)
+{
+    *s = *s * 6364136223846793005ull + 1442695040888963407ull;
+    return (double)(*s >> 11) / 9007199254740992.0;
+}
+
+static double gauss(uint64_t* s)
+{
+    double u = rnd(s) + 1e-300, v = rnd(s);
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static void cube_points(std::vector<ch_vertex>& pts, int n, uint64_t seed)
+{
+    pts.resize(n);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < 3; j++)
+            pts[i][j] = 2.0 * rnd(&seed) - 1.0;
+}
+
+static void gauss_points(std::vector<ch_vertex>& pts, int n, double sigma, uint64_t seed)
+{
+    pts.resize(n);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < 3; j++)
+            pts[i][j] = sigma * gauss(&seed);
+}
+
+static double signed_volume(const std::vector<ch_vertex>& pts, const int* faces, int nFaces)
+{
+    double vol = 0.0;
+    for (int f = 0; f < nFaces; f++) {
+        const ch_vertex &a = pts[faces[f * 3]], &b = pts[faces[f * 3 + 1]], &c = pts[faces[f * 3 + 2]];
+        vol += a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) + a[2] * (b[0] * c[1] - b[1] * c[0]);
+    }
+    return vol / 6.0;
+}
+
+/* Checks the faces of 'hull' against the points that are in it ('alive'), and returns the largest distance of any of
+ * them above a face */
+static double check_hull(convhull_3d_hull* hull, const std::vector<ch_vertex>& pts, const std::vector<char>& alive,
+                         const char* what)
+{
+    int *faces, nFaces, f, k, p, nAlive;
+    double worst = 0.0;
+    std::map<std::pair<int, int>, int> edges;
+    std::vector<ch_vertex> live;
+
+    convhull_3d_hull_faces(hull, &faces, &nFaces);
+    for (p = 0, nAlive = 0; p < (int)pts.size(); p++)
+        nAlive += alive[p];
+    CHECK(nFaces > 0 || nAlive < 4, "%s: no faces with %d points", what, nAlive);
+    for (f = 0; f < nFaces; f++) {
+        for (k = 0; k < 3; k++) {
+            CHECK(faces[f * 3 + k] >= 0 && faces[f * 3 + k] < (int)pts.size() && alive[faces[f * 3 + k]],
+                  "%s: face %d has vertex %d, which is not in the hull", what, f, faces[f * 3 + k]);
+            edges[std::make_pair(faces[f * 3 + k], faces[f * 3 + (k + 1) % 3])]++;
+        }
+    }
+    for (std::map<std::pair<int, int>, int>::iterator it = edges.begin(); it != edges.end(); ++it) {
+        std::map<std::pair<int, int>, int>::iterator rev = edges.find(std::make_pair(it->first.second, it->first.first));
+        CHECK(it->second == 1 && rev != edges.end() && rev->second == 1, "%s: edge (%d, %d) is not shared by two faces",
+              what, it->first.first, it->first.second);
+    }
+
+    /* the (unit) outward normal of each face, and the distance of each point above it */
+    for (f = 0; f < nFaces; f++) {
+        const ch_vertex &a = pts[faces[f * 3]], &b = pts[faces[f * 3 + 1]], &c = pts[faces[f * 3 + 2]];
+        double u[3], v[3], n[3], len;
+        for (k = 0; k < 3; k++) {
+            u[k] = b[k] - a[k];
+            v[k] = c[k] - a[k];
+        }
+        n[0] = u[1] * v[2] - u[2] * v[1];
+        n[1] = u[2] * v[0] - u[0] * v[2];
+        n[2] = u[0] * v[1] - u[1] * v[0];
+        len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (len < 1e-12)
+            continue;
+        for (p = 0; p < (int)pts.size(); p++)
+            if (alive[p])
+                worst = MAX(worst, (n[0] * (pts[p][0] - a[0]) + n[1] * (pts[p][1] - a[1]) + n[2] * (pts[p][2] - a[2])) / len);
+    }
+    CHECK(worst < 1e-6, "%s: a point is %g above a face", what, worst);
+
+    /* the volume of a hull built from scratch */
+    if (nFaces > 0) {
+        int *ref, nRef;
+        for (p = 0; p < (int)pts.size(); p++)
+            if (alive[p])
+                live.push_back(pts[p]);
+        convhull_3d_build(live.data(), (int)live.size(), &ref, &nRef);
+        double v0 = signed_volume(live, ref, nRef), v1 = signed_volume(pts, faces, nFaces);
+        CHECK(fabs(v1 - v0) <= 1e-9 * MAX(1.0, fabs(v0)), "%s: volume %.12g, but %.12g when built from scratch", what,
+              v1, v0);
+        free(ref);
+    }
+    return worst;
+}
+
+/* Inserts the points in a few batches, then removes (in batches of 7) every point with x > xcut; which peels the hull
+ * away from one side, so that the centre about which the interior points are kept ends up outside of it */
+static void test_peel(const std::vector<ch_vertex>& pts, int exact, double xcut, const char* name)
+{
+    convhull_3d_options options;
+    convhull_3d_hull* hull;
+    std::vector<char> alive(pts.size(), 0);
+    std::vector<int> batch;
+    char what[128];
+    int i, n = (int)pts.size();
+
+    convhull_3d_options_default(&options);
+    options.exact_predicates = exact;
+    hull = convhull_3d_hull_create(&options);
+    for (i = 0; i < n; i += 1000) {
+        int m = MIN(1000, n - i);
+        CHECK(convhull_3d_insert(hull, (ch_vertex*)&pts[i], m) == CH_OK, "%s: insert failed", name);
+        for (int j = i; j < i + m; j++)
+            alive[j] = 1;
+    }
+    snprintf(what, sizeof(what), "%s (exact %d) after inserting", name, exact);
+    check_hull(hull, pts, alive, what);
+
+    for (i = 0; i < n; i++) {
+        if (pts[i][0] > xcut)
+            batch.push_back(i);
+        if ((int)batch.size() == 7 || (i == n - 1 && !batch.empty())) {
+            CHECK(convhull_3d_remove(hull, batch.data(), (int)batch.size()) == CH_OK, "%s: remove failed", name);
+            for (size_t j = 0; j < batch.size(); j++)
+                alive[batch[j]] = 0;
+            batch.clear();
+            snprintf(what, sizeof(what), "%s (exact %d) after removing up to point %d", name, exact, i);
+            if (check_hull(hull, pts, alive, what) >= 1e-6)
+                break; /* one report per run is enough */
+        }
+    }
+    convhull_3d_hull_destroy(hull);
+}
+
+/* Moves random points to new random positions, and removes and re-inserts others, checking the hull as it goes */
+static void test_churn(int exact)
+{
+    convhull_3d_options options;
+    convhull_3d_hull* hull;
+    std::vector<ch_vertex> pts, moved;
+    std::vector<char> alive;
+    std::vector<int> idx;
+    uint64_t s = 7;
+    char what[128];
+    int i, r, n = 2000;
+
+    convhull_3d_options_default(&options);
+    options.exact_predicates = exact;
+    hull = convhull_3d_hull_create(&options);
+    gauss_points(pts, n, 0.4, 3);
+    alive.assign(n, 1);
+    CHECK(convhull_3d_insert(hull, pts.data(), n) == CH_OK, "churn: insert failed");
+    for (r = 0; r < 40; r++) {
+        idx.clear();
+        moved.clear();
+        for (i = 0; i < 25; i++) {
+            int p = (int)(rnd(&s) * n);
+            idx.push_back(p);
+            ch_vertex v;
+            for (int j = 0; j < 3; j++)
+                v[j] = 0.4 * gauss(&s);
+            moved.push_back(v);
+        }
+        CHECK(convhull_3d_move(hull, idx.data(), moved.data(), (int)idx.size()) == CH_OK, "churn: move failed");
+        for (i = 0; i < (int)idx.size(); i++)
+            if (alive[idx[i]])
+                pts[idx[i]] = moved[i];
+
+        /* remove the current vertices of one face */
+        int *faces, nFaces;
+        convhull_3d_hull_faces(hull, &faces, &nFaces);
+        idx.assign(faces, faces + 3);
+        CHECK(convhull_3d_remove(hull, idx.data(), 3) == CH_OK, "churn: remove failed");
+        for (i = 0; i < 3; i++)
+            alive[idx[i]] = 0;
+
+        snprintf(what, sizeof(what), "churn (exact %d) round %d", exact, r);
+        check_hull(hull, pts, alive, what);
+    }
+    convhull_3d_hull_destroy(hull);
+}
+
+/* The faces, each rotated to start from its lowest index, in sorted order; so that two lists of the same faces compare
+ * equal */
+static std::vector<int> face_set(const int* faces, int nFaces)
+{
+    std::vector<std::vector<int> > set(nFaces);
+    std::vector<int> out;
+    for (int f = 0; f < nFaces; f++) {
+        const int* t = &faces[f * 3];
+        int k = t[0] < t[1] ? (t[0] < t[2] ? 0 : 2) : (t[1] < t[2] ? 1 : 2);
+        for (int j = 0; j < 3; j++)
+            set[f].push_back(t[(k + j) % 3]);
+    }
+    std::sort(set.begin(), set.end());
+    for (int f = 0; f < nFaces; f++)
+        out.insert(out.end(), set[f].begin(), set[f].end());
+    return out;
+}
+
+/* Points in a flattened ball that move a little from one frame to the next; each frame is built from scratch, and
+ * warm-started from the previous frame's hull (passed straight back in), and the two must have the same faces. A hint
+ * with indices that are out of range, and one with too few vertices, must also give the same faces */
+static void test_hint(int exact)
+{
+    convhull_3d_options options;
+    convhull_3d_context *cold, *warm;
+    std::vector<ch_vertex> pts;
+    std::vector<int> ref;
+    int *faces, nFaces, *hint, nHint, i, j, r, n = 20000;
+    int bad[6] = { 0, n, 1, -5, 2, 3 }; /* two faces; the second has only two vertices in range */
+    uint64_t s = 11;
+
+    convhull_3d_options_default(&options);
+    options.exact_predicates = exact;
+    cold = convhull_3d_context_create();
+    warm = convhull_3d_context_create();
+    gauss_points(pts, n, 1.0, 9);
+    for (i = 0; i < n; i++)
+        pts[i][2] *= 0.3;
+    hint = NULL;
+    nHint = 0;
+    for (r = 0; r < 10; r++) {
+        CHECK(convhull_3d_build_ctx(cold, pts.data(), n, &options, &faces, &nFaces) == CH_OK,
+              "hint: cold build failed");
+        ref = face_set(faces, nFaces);
+        CHECK(convhull_3d_build_hint(warm, pts.data(), n, &options, hint, nHint, &hint, &nHint) == CH_OK,
+              "hint: warm build failed");
+        CHECK(face_set(hint, nHint) == ref, "hint (exact %d): frame %d differs from the cold build", exact, r);
+        for (i = 0; i < n; i++)
+            for (j = 0; j < 3; j++)
+                pts[i][j] += 1e-3 * (rnd(&s) - 0.5);
+    }
+    CHECK(convhull_3d_build_ctx(cold, pts.data(), n, &options, &faces, &nFaces) == CH_OK, "hint: cold build failed");
+    ref = face_set(faces, nFaces);
+    CHECK(convhull_3d_build_hint(warm, pts.data(), n, &options, bad, 2, &faces, &nFaces) == CH_OK &&
+          face_set(faces, nFaces) == ref, "hint (exact %d): out of range indices", exact);
+    CHECK(convhull_3d_build_hint(warm, pts.data(), n, &options, bad + 3, 1, &faces, &nFaces) == CH_OK &&
+          face_set(faces, nFaces) == ref, "hint (exact %d): too few vertices", exact);
+    convhull_3d_context_destroy(cold);
+    convhull_3d_context_destroy(warm);
+}
+
+int main(void)
+{
+    std::vector<ch_vertex> pts;
+
+    /* (with these seeds, removing the last few points used to leave points outside of the hull) */
+    for (int exact = 0; exact < 2; exact++) {
+        cube_points(pts, 4000, 36);
+        test_peel(pts, exact, -0.7, "cube");
+        gauss_points(pts, 4000, 1.0, 35);
+        test_peel(pts, exact, -0.7, "gaussian");
+        test_churn(exact);
+        test_hint(exact);
+    }
+    printf("%s (%d failed)\n", nFailed == 0 ? "PASSED" : "FAILED", nFailed);
+    return nFailed;
+}
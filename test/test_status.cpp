@@ -0,0 +1,440 @@
+/*
+ Copyright (c) 2017-2021 Leo McCormack
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in
+ all copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ THE SOFTWARE.
+*/
+
+/* Checks that each ch_status is returned when it should be, by the 3-D and N-D builders: degenerate inputs, faces that
+ * cannot be oriented, face budgets, failed allocations (every allocation is made to fail in turn), out of range
+ * arguments, and builds that are cancelled or run out of time (which must return the hull of the points taken up so
+ * far). Worker threads that cannot be started must have their share done on the calling thread, with the same output;
+ * and the output of a parallel or batch build must not depend on the number of threads.
+ * The outputs must be NULL unless CH_OK or CH_CANCELLED is returned. Nothing here relies on exceptions, so it may
+ * be built with or without -fno-exceptions, e.g.:
+ *   g++ -std=c++17 -O2 -fno-exceptions -I.. test_status.cpp -o test_status
+ * The exit code is the number of failed checks */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+
+/* an allocator that fails on the g_fail'th call (counting from 0), if g_fail >= 0 */
+static std::atomic<long> g_count(0); /* (atomic, as the parallel builds allocate from several threads) */
+static long g_fail = -1;
+static void* test_malloc(size_t n) { return g_count++ == g_fail ? NULL : malloc(n); }
+static void* test_calloc(size_t n, size_t m) { return g_count++ == g_fail ? NULL : calloc(n, m); }
+static void* test_realloc(void* p, size_t n) { return g_count++ == g_fail ? NULL : realloc(p, n); }
+#define ch_malloc test_malloc
+#define ch_calloc test_calloc
+#define ch_realloc test_realloc
+#define ch_free free
+
+/* thread creation that fails for every g_thread_fail'th thread, if g_thread_fail > 0 */
+#include <pthread.h>
+static int g_threads = 0, g_thread_fail = 0;
+static int test_pthread_create(pthread_t* th, const pthread_attr_t* attr, void* (*fn)(void*), void* arg)
+{
+    return g_thread_fail > 0 && g_threads++ % g_thread_fail == 0 ? 11 /* EAGAIN */ : pthread_create(th, attr, fn, arg);
+}
+#define ch_pthread_create test_pthread_create
+#define CONVHULL_3D_ENABLE
+#include "convhull_3d.h"
+
+static int nFailed = 0;
+
+#define CHECK(cond, ...)                     \
+    do {                                     \
+        if (!(cond)) {                       \
+            printf("FAILED: " __VA_ARGS__);  \
+            printf("\n");                    \
+            nFailed++;                       \
+        }                                    \
+    } while (0)
+
+/* uniform in [0, 1), from a 64-bit LCG; so that the points are the same on every platform */
+static double rnd(uint64_t* s)
+{
+    *s = *s * 6364136223846793005ull + 1442695040888963407ull;
+    return (double)(*s >> 11) / 9007199254740992.0;
+}
+
+static void random_points(std::vector<CH_FLOAT>& pts, int n, int d, uint64_t seed)
+{
+    pts.resize(size_t(n) * d);
+    for (size_t i = 0; i < pts.size(); i++)
+        pts[i] = 2.0 * rnd(&seed) - 1.0;
+}
+
+/* the largest distance of a vertex of the hull above one of its faces (along the plane coefficients), which should
+ * be next to nothing for any convex hull */
+static double nd_convexity(const std::vector<CH_FLOAT>& pts, int d, const int* faces, const CH_FLOAT* cf,
+                           const CH_FLOAT* df, int nFaces)
+{
+    double worst = 0.0;
+    for (int f = 0; f < nFaces; f++)
+        for (int g = 0; g < nFaces * d; g++) {
+            double v = df[f];
+            for (int j = 0; j < d; j++)
+                v += cf[f * d + j] * pts[faces[g] * d + j];
+            worst = MAX(worst, v);
+        }
+    return worst;
+}
+
+/* The faces, each rotated to start from its lowest index, in sorted order; so that two lists of the same faces compare
+ * equal */
+static std::vector<int> face_set(const int* faces, int nFaces)
+{
+    std::vector<std::vector<int> > set(nFaces);
+    std::vector<int> out;
+    for (int f = 0; f < nFaces; f++) {
+        const int* t = &faces[f * 3];
+        int k = t[0] < t[1] ? (t[0] < t[2] ? 0 : 2) : (t[1] < t[2] ? 1 : 2);
+        for (int j = 0; j < 3; j++)
+            set[f].push_back(t[(k + j) % 3]);
+    }
+    std::sort(set.begin(), set.end());
+    for (int f = 0; f < nFaces; f++)
+        out.insert(out.end(), set[f].begin(), set[f].end());
+    return out;
+}
+
+static void test_3d(void)
+{
+    std::vector<CH_FLOAT> p;
+    std::vector<ch_vertex> v;
+    convhull_3d_options options;
+    convhull_3d_context* ctx;
+    ch_status status;
+    int *faces, nFaces, i;
+
+    random_points(p, 20000, 3, 1);
+    v.resize(20000);
+    for (i = 0; i < 20000; i++)
+        v[i] = ch_vertex{ { p[i * 3], p[i * 3 + 1], p[i * 3 + 2] } };
+
+    status = convhull_3d_build_ex(v.data(), 20000, NULL, &faces, &nFaces);
+    CHECK(status == CH_OK && faces != NULL && nFaces > 0, "3-D: status %d", status);
+    free(faces);
+
+    /* coplanar points */
+    std::vector<ch_vertex> flat(v.begin(), v.begin() + 1000);
+    for (i = 0; i < 1000; i++)
+        flat[i][2] = 0.5;
+    status = convhull_3d_build_ex(flat.data(), 1000, NULL, &faces, &nFaces);
+    CHECK(status == CH_ERROR_DEGENERATE && faces == NULL && nFaces == 0, "3-D coplanar: status %d", status);
+
+    /* face budget */
+    convhull_3d_options_default(&options);
+    options.max_faces = 50;
+    status = convhull_3d_build_ex(v.data(), 20000, &options, &faces, &nFaces);
+    CHECK(status == CH_ERROR_FACE_BUDGET && faces == NULL, "3-D face budget: status %d", status);
+
+    /* cancelled before it starts, and by a time budget that runs out straight away; either way, the hull of the points
+     * taken up so far is returned */
+    std::atomic<int> cancel(1);
+    ctx = convhull_3d_context_create();
+    convhull_3d_options_default(&options);
+    options.cancel = &cancel;
+    status = convhull_3d_build_ctx(ctx, v.data(), 20000, &options, &faces, &nFaces);
+    CHECK(status == CH_CANCELLED && convhull_3d_unprocessed(ctx) > 0, "3-D cancel: status %d, %d unprocessed", status,
+          convhull_3d_unprocessed(ctx));
+    convhull_3d_options_default(&options);
+    options.time_budget = 1e-9;
+    status = convhull_3d_build_ctx(ctx, v.data(), 20000, &options, &faces, &nFaces);
+    CHECK(status == CH_CANCELLED && faces != NULL && nFaces >= 4, "3-D time budget: status %d, %d faces", status,
+          nFaces);
+    convhull_3d_context_destroy(ctx);
+
+    /* every allocation failing in turn; a few of them may be done without (e.g. the k-DOP culling is skipped) */
+    for (g_fail = 0, i = 0;; g_fail++) {
+        g_count = 0;
+        status = convhull_3d_build_ex(v.data(), 20000, NULL, &faces, &nFaces);
+        if (g_count <= g_fail)
+            break;
+        CHECK(status == CH_OK || (status == CH_ERROR_MEMORY && faces == NULL && nFaces == 0),
+              "3-D: allocation %ld failed, but status %d", g_fail, status);
+        i += status == CH_ERROR_MEMORY;
+        free(faces);
+    }
+    g_fail = -1;
+    CHECK(status == CH_OK && i > 0, "3-D: status %d without allocation failures, %d CH_ERROR_MEMORY", status, i);
+    free(faces);
+}
+
+static void test_nd(int d)
+{
+    std::vector<CH_FLOAT> p;
+    convhull_3d_options options;
+    ch_status status;
+    CH_FLOAT *cf, *df;
+    int *faces, nFaces, n, i, j, k, t;
+
+    n = d == 2 ? 5000 : 2000;
+    random_points(p, n, d, 2);
+    status = convhull_nd_build_ex(p.data(), n, d, NULL, &faces, &cf, &df, &nFaces);
+    CHECK(status == CH_OK && faces != NULL && nFaces > 0, "%d-D: status %d", d, status);
+    if (status == CH_OK)
+        CHECK(nd_convexity(p, d, faces, cf, df, nFaces) < 1e-6, "%d-D: not convex", d);
+    free(faces);
+    free(cf);
+    free(df);
+
+    /* points that do not span the last dimension */
+    std::vector<CH_FLOAT> flat(p);
+    for (i = 0; i < n; i++)
+        flat[i * d + d - 1] = 0.25;
+    status = convhull_nd_build_ex(flat.data(), n, d, NULL, &faces, &cf, &df, &nFaces);
+    CHECK(status == CH_ERROR_DEGENERATE && faces == NULL && cf == NULL && df == NULL && nFaces == 0,
+          "%d-D degenerate: status %d", d, status);
+
+    if (d > 2) {
+        /* face budget */
+        convhull_3d_options_default(&options);
+        options.max_faces = d + 2;
+        status = convhull_nd_build_ex(p.data(), n, d, &options, &faces, &cf, NULL, &nFaces);
+        CHECK(status == CH_ERROR_FACE_BUDGET && faces == NULL && cf == NULL, "%d-D face budget: status %d", d, status);
+
+        /* cancelled, and out of time; the partial hull must still be convex */
+        std::atomic<int> cancel(1);
+        convhull_3d_options_default(&options);
+        options.cancel = &cancel;
+        status = convhull_nd_build_ex(p.data(), n, d, &options, &faces, &cf, &df, &nFaces);
+        CHECK(status == CH_CANCELLED && nFaces == d + 1, "%d-D cancel: status %d, %d faces", d, status, nFaces);
+        free(faces);
+        free(cf);
+        free(df);
+        convhull_3d_options_default(&options);
+        options.time_budget = 1e-9;
+        status = convhull_nd_build_ex(p.data(), n, d, &options, &faces, &cf, &df, &nFaces);
+        CHECK(status == CH_CANCELLED && nFaces > 0 && nd_convexity(p, d, faces, cf, df, nFaces) < 1e-6,
+              "%d-D time budget: status %d, %d faces", d, status, nFaces);
+        free(faces);
+        free(cf);
+        free(df);
+
+        /* a grid, so far from the origin that the noise is lost; the faces then no longer fit together */
+        std::vector<CH_FLOAT> grid;
+        for (i = 0, k = 1; i < d; i++)
+            k *= 3;
+        for (i = 0; i < k; i++)
+            for (j = 0, t = i; j < d; j++, t /= 3)
+                grid.push_back((t % 3) * 1e12);
+        convhull_3d_options_default(&options);
+        options.insertion_order = CH_ORDER_MORTON;
+        status = convhull_nd_build_ex(grid.data(), k, d, &options, &faces, &cf, &df, &nFaces);
+        CHECK(status == CH_ERROR_NUMERIC || status == CH_OK, "%d-D grid: status %d", d, status);
+        if (d == 3)
+            CHECK(status == CH_ERROR_NUMERIC && faces == NULL, "%d-D grid: status %d", d, status);
+        free(faces);
+        free(cf);
+        free(df);
+    }
+
+    /* every allocation failing in turn */
+    for (g_fail = 0, i = 0;; g_fail++) {
+        g_count = 0;
+        status = convhull_nd_build_ex(p.data(), n, d, NULL, &faces, &cf, &df, &nFaces);
+        if (g_count <= g_fail)
+            break;
+        CHECK(status == CH_OK || (status == CH_ERROR_MEMORY && faces == NULL && cf == NULL && df == NULL && nFaces == 0),
+              "%d-D: allocation %ld failed, but status %d", d, g_fail, status);
+        i += status == CH_ERROR_MEMORY;
+        free(faces);
+        free(cf);
+        free(df);
+    }
+    g_fail = -1;
+    CHECK(status == CH_OK && i > 0, "%d-D: status %d without allocation failures, %d CH_ERROR_MEMORY", d, status, i);
+    free(faces);
+    free(cf);
+    free(df);
+}
+
+/* Builds on several threads, with none, every other, or all of the worker threads failing to start; the output must
+ * be the same each time */
+static void test_threads(void)
+{
+    std::vector<CH_FLOAT> p;
+    std::vector<ch_vertex> v;
+    std::vector<int> ref[4];
+    convhull_3d_options options;
+    convhull_3d_context* ctx;
+    convhull_3d_batch_item items[6];
+    ch_status status;
+    int *faces, nFaces, i, k, fail, n = 100000;
+
+    random_points(p, n, 3, 4);
+    v.resize(n);
+    for (i = 0; i < n; i++)
+        v[i] = ch_vertex{ { p[i * 3], p[i * 3 + 1], p[i * 3 + 2] } };
+    convhull_3d_options_default(&options);
+    options.num_threads = 4;
+    options.insertion_order = CH_ORDER_MORTON; /* so that the radix sort is also spread over the threads */
+    ctx = convhull_3d_context_create();
+    for (fail = 0; fail <= 2; fail++) {
+        g_thread_fail = fail == 0 ? 0 : (fail == 1 ? 2 : 1);
+        for (k = 0; k < 4; k++) {
+            std::vector<int> out;
+            if (k == 0) { /* k-DOP culling and sorting */
+                status = convhull_3d_build_ex(v.data(), n, &options, &faces, &nFaces);
+                out.assign(faces, faces + (status == CH_OK ? nFaces * 3 : 0));
+                free(faces);
+            }
+            else if (k == 1) { /* the 2-D sort */
+                status = convhull_nd_build_ex(p.data(), n, 2, &options, &faces, NULL, NULL, &nFaces);
+                out.assign(faces, faces + (status == CH_OK ? nFaces * 2 : 0));
+                free(faces);
+            }
+            else if (k == 2) {
+                status = convhull_3d_build_parallel(ctx, v.data(), n, &options, &faces, &nFaces);
+                out.assign(faces, faces + (status == CH_OK ? nFaces * 3 : 0));
+            }
+            else {
+                for (i = 0; i < 6; i++) {
+                    items[i].vertices = v.data() + i * 1000;
+                    items[i].nVert = 1000 + i * 500;
+                }
+                convhull_3d_build_batch(ctx, items, 6, &options);
+                for (i = 0, status = CH_OK; i < 6; i++) {
+                    status = items[i].status != CH_OK ? items[i].status : status;
+                    out.insert(out.end(), items[i].faces, items[i].faces + items[i].nFaces * 3);
+                    out.push_back(-1);
+                    free(items[i].faces);
+                }
+            }
+            CHECK(status == CH_OK && !out.empty(), "threads (failing %d): build %d, status %d", g_thread_fail, k, status);
+            if (fail == 0)
+                ref[k] = out;
+            else
+                CHECK(out == ref[k], "threads (failing %d): build %d differs from that with all of the threads",
+                      g_thread_fail, k);
+        }
+    }
+    g_thread_fail = 0;
+    convhull_3d_context_destroy(ctx);
+}
+
+/* The output of convhull_3d_build_parallel() must depend only on the number of chunks, and not on the number of
+ * threads; and the hull of the sub-hulls must be the hull of all of the points */
+static void test_parallel(void)
+{
+    std::vector<CH_FLOAT> p;
+    std::vector<ch_vertex> v;
+    std::vector<int> ref, whole;
+    convhull_3d_options options;
+    convhull_3d_context* ctx;
+    ch_status status;
+    int *faces, nFaces, i, t, n = 100000;
+    const int nThreads[4] = { 1, 2, 3, 8 };
+
+    random_points(p, n, 3, 5);
+    v.resize(n);
+    for (i = 0; i < n; i++)
+        v[i] = ch_vertex{ { p[i * 3], p[i * 3 + 1], p[i * 3 + 2] } };
+    ctx = convhull_3d_context_create();
+    convhull_3d_options_default(&options);
+    status = convhull_3d_build_ctx(ctx, v.data(), n, &options, &faces, &nFaces);
+    whole = face_set(faces, status == CH_OK ? nFaces : 0);
+    options.num_chunks = 8;
+    for (t = 0; t < 4; t++) {
+        options.num_threads = nThreads[t];
+        status = convhull_3d_build_parallel(ctx, v.data(), n, &options, &faces, &nFaces);
+        CHECK(status == CH_OK && nFaces > 0, "parallel (%d threads): status %d", nThreads[t], status);
+        std::vector<int> out(faces, faces + (status == CH_OK ? nFaces * 3 : 0));
+        if (t == 0) {
+            ref = out;
+            CHECK(face_set(faces, nFaces) == whole, "parallel: the faces differ from those of a serial build");
+        }
+        else
+            CHECK(out == ref, "parallel: the faces with %d threads differ from those with 1", nThreads[t]);
+    }
+    convhull_3d_context_destroy(ctx);
+}
+
+/* The output of each item of convhull_3d_build_batch() must not depend on the number of threads */
+static void test_batch(void)
+{
+    std::vector<CH_FLOAT> p;
+    std::vector<ch_vertex> v;
+    std::vector<int> ref[12];
+    convhull_3d_options options;
+    convhull_3d_context* ctx;
+    convhull_3d_batch_item items[12];
+    int i, t, n = 0;
+    const int nThreads[4] = { 1, 2, 5, 12 };
+
+    for (i = 0; i < 12; i++)
+        n += 50 + (i * 7919) % 3000; /* items of all sizes, in no particular order */
+    random_points(p, n, 3, 6);
+    v.resize(n);
+    for (i = 0; i < n; i++)
+        v[i] = ch_vertex{ { p[i * 3], p[i * 3 + 1], p[i * 3 + 2] } };
+    ctx = convhull_3d_context_create();
+    convhull_3d_options_default(&options);
+    for (t = 0; t < 4; t++) {
+        options.num_threads = nThreads[t];
+        for (i = 0, n = 0; i < 12; i++) {
+            items[i].vertices = v.data() + n;
+            items[i].nVert = 50 + (i * 7919) % 3000;
+            n += items[i].nVert;
+        }
+        convhull_3d_build_batch(ctx, items, 12, &options);
+        for (i = 0; i < 12; i++) {
+            CHECK(items[i].status == CH_OK && items[i].nFaces > 0, "batch (%d threads): item %d, status %d",
+                  nThreads[t], i, items[i].status);
+            std::vector<int> out(items[i].faces, items[i].faces + (items[i].status == CH_OK ? items[i].nFaces * 3 : 0));
+            if (t == 0)
+                ref[i] = out;
+            else
+                CHECK(out == ref[i], "batch: item %d differs with %d threads from with 1", i, nThreads[t]);
+            free(items[i].faces);
+        }
+    }
+    convhull_3d_context_destroy(ctx);
+}
+
+int main(void)
+{
+    std::vector<CH_FLOAT> p;
+    ch_status status;
+    int *faces, nFaces;
+
+    test_3d();
+    for (int d = 2; d <= 5; d++)
+        test_nd(d);
+    test_threads();
+    test_parallel();
+    test_batch();
+
+    /* out of range numbers of dimensions */
+    random_points(p, 100, CONVHULL_ND_MAX_DIMENSIONS + 1, 3);
+    status = convhull_nd_build_ex(p.data(), 100, CONVHULL_ND_MAX_DIMENSIONS + 1, NULL, &faces, NULL, NULL, &nFaces);
+    CHECK(status == CH_ERROR_INVALID_ARGUMENT && faces == NULL, "d = %d: status %d", CONVHULL_ND_MAX_DIMENSIONS + 1,
+          status);
+    status = convhull_nd_build_ex(p.data(), 100, 1, NULL, &faces, NULL, NULL, &nFaces);
+    CHECK(status == CH_ERROR_INVALID_ARGUMENT && faces == NULL, "d = 1: status %d", status);
+
+    printf("%s (%d failed)\n", nFailed == 0 ? "PASSED" : "FAILED", nFailed);
+    return nFailed;
+}